@@ -0,0 +1,247 @@
+/*
+ * synthetic client used by 'make bench'
+ * creates a set of windows (solid, ARGB, shaped and translucent through _NET_WM_WINDOW_OPACITY)
+ * and drives scripted damage, map/unmap and restack patterns against them
+ */
+#include <X11/Xatom.h>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/shape.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#define OPAQUE 0xFFFFFFFF
+
+#define eprintf(...) (fprintf(stderr, __VA_ARGS__), exit(EXIT_FAILURE))
+
+typedef enum _client_kind {
+    KIND_SOLID,
+    KIND_ARGB,
+    KIND_SHAPED,
+    KIND_OPACITY,
+    NUM_KINDS
+} client_kind;
+
+typedef enum _pattern {
+    PATTERN_DAMAGE = 1,
+    PATTERN_MAP = 2,
+    PATTERN_RESTACK = 4,
+    PATTERN_ALL = 7
+} pattern;
+
+typedef struct _client {
+    Window id;
+    GC gc;
+    client_kind kind;
+    int width, height;
+    Bool mapped;
+} client;
+
+static Display *dpy;
+static client *clients;
+static int n_clients = 32;
+
+static void usage(const char *program, Bool failed) {
+    fprintf(stderr, "usage: %s [options]\n%s\n", program,
+            "Options:\n"
+            "   -d display\n"
+            "      Specifies which display should be used.\n"
+            "   -n count\n"
+            "      Number of windows to create (default: 32).\n"
+            "   -t seconds\n"
+            "      Duration of the workload (default: 10).\n"
+            "   -r rate\n"
+            "      Workload steps per second (default: 60).\n"
+            "   -p pattern\n"
+            "      One of damage, map, restack or all (default: all).\n"
+            "   -h help\n"
+            "      Show this message.\n");
+
+    exit(failed ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+static double get_time(void) {
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static pattern get_pattern_from_name(const char *name) {
+    if (strcmp(name, "damage") == 0)
+        return PATTERN_DAMAGE;
+    if (strcmp(name, "map") == 0)
+        return PATTERN_MAP;
+    if (strcmp(name, "restack") == 0)
+        return PATTERN_RESTACK;
+    if (strcmp(name, "all") == 0)
+        return PATTERN_ALL;
+    return 0;
+}
+
+static void create_client(client *c, client_kind kind, int x, int y) {
+    int screen = DefaultScreen(dpy);
+    Window root = RootWindow(dpy, screen);
+    XSetWindowAttributes attr;
+    unsigned long mask = CWOverrideRedirect | CWBackPixel | CWBorderPixel;
+    XVisualInfo vinfo;
+    Visual *visual = DefaultVisual(dpy, screen);
+    int depth = DefaultDepth(dpy, screen);
+
+    c->kind = kind;
+    c->width = 200 + rand() % 200;
+    c->height = 150 + rand() % 150;
+    c->mapped = False;
+
+    // override redirect windows are mapped without a window manager
+    attr.override_redirect = True;
+    attr.background_pixel = 0;
+    attr.border_pixel = 0;
+
+    if (kind == KIND_ARGB) {
+        if (XMatchVisualInfo(dpy, screen, 32, TrueColor, &vinfo)) {
+            visual = vinfo.visual;
+            depth = vinfo.depth;
+            attr.colormap = XCreateColormap(dpy, root, visual, AllocNone);
+            mask |= CWColormap;
+        } else {
+            c->kind = KIND_SOLID;
+        }
+    }
+
+    c->id = XCreateWindow(dpy, root, x, y, c->width, c->height, 0, depth,
+                          InputOutput, visual, mask, &attr);
+    c->gc = XCreateGC(dpy, c->id, 0, NULL);
+
+    if (c->kind == KIND_SHAPED) {
+        XRectangle rects[2] = {
+            {0, 0, c->width, c->height / 2},
+            {c->width / 4, c->height / 2, c->width / 2, c->height / 2}};
+        XShapeCombineRectangles(dpy, c->id, ShapeBounding, 0, 0, rects, 2, ShapeSet, Unsorted);
+    } else if (c->kind == KIND_OPACITY) {
+        unsigned long opacity = 0.8 * OPAQUE;
+        XChangeProperty(dpy, c->id, XInternAtom(dpy, "_NET_WM_WINDOW_OPACITY", False),
+                        XA_CARDINAL, 32, PropModeReplace, (unsigned char *) &opacity, 1);
+    }
+}
+
+static void damage_client(client *c) {
+    int w = 10 + rand() % (c->width / 2);
+    int h = 10 + rand() % (c->height / 2);
+
+    XSetForeground(dpy, c->gc, (0xFFU << 24) | (rand() & 0xFFFFFF));
+    XFillRectangle(dpy, c->id, c->gc, rand() % (c->width - w), rand() % (c->height - h), w, h);
+}
+
+static void toggle_client(client *c) {
+    if (c->mapped)
+        XUnmapWindow(dpy, c->id);
+    else
+        XMapWindow(dpy, c->id);
+    c->mapped = !c->mapped;
+}
+
+static void run_step(pattern p) {
+    client *c = &clients[rand() % n_clients];
+
+    if (p & PATTERN_DAMAGE) {
+        // damage a few windows per step so a frame has more than one damaged area
+        for (int i = 0; i < 4; i++) {
+            client *d = &clients[rand() % n_clients];
+            if (d->mapped)
+                damage_client(d);
+        }
+    }
+    if (p & PATTERN_MAP)
+        toggle_client(c);
+    if ((p & PATTERN_RESTACK) && c->mapped)
+        XRaiseWindow(dpy, c->id);
+}
+
+int main(int argc, char **argv) {
+    char *display = NULL;
+    double duration = 10.0;
+    int rate = 60;
+    pattern p = PATTERN_ALL;
+    int o;
+
+    while ((o = getopt(argc, argv, "hd:n:t:r:p:")) != -1) {
+        switch (o) {
+        case 'h':
+            usage(argv[0], False);
+            break;
+        case 'd':
+            display = optarg;
+            break;
+        case 'n':
+            n_clients = atoi(optarg);
+            break;
+        case 't':
+            duration = atof(optarg);
+            break;
+        case 'r':
+            rate = atoi(optarg);
+            break;
+        case 'p':
+            p = get_pattern_from_name(optarg);
+            break;
+        default:
+            usage(argv[0], True);
+            break;
+        }
+    }
+    if (n_clients <= 0 || rate <= 0 || !p)
+        usage(argv[0], True);
+
+    dpy = XOpenDisplay(display);
+    if (!dpy)
+        eprintf("cannot open display\n");
+
+    // fixed seed so every run replays the same workload
+    srand(1);
+
+    int root_width = DisplayWidth(dpy, DefaultScreen(dpy));
+    int root_height = DisplayHeight(dpy, DefaultScreen(dpy));
+    clients = calloc(n_clients, sizeof(client));
+    if (!clients)
+        eprintf("calloc: out of memory\n");
+    for (int i = 0; i < n_clients; i++) {
+        create_client(&clients[i], i % NUM_KINDS, rand() % (root_width - 200), rand() % (root_height - 150));
+        toggle_client(&clients[i]);
+        damage_client(&clients[i]);
+    }
+    XSync(dpy, False);
+
+    unsigned long int steps = 0;
+    unsigned long int start_request = NextRequest(dpy);
+    double start = get_time();
+    double next = start;
+    while (get_time() - start < duration) {
+        run_step(p);
+        XFlush(dpy);
+        steps++;
+
+        next += 1.0 / rate;
+        double delay = next - get_time();
+        if (delay > 0)
+            usleep(delay * 1e6);
+    }
+    XSync(dpy, False);
+
+    printf("client windows: %i\n", n_clients);
+    printf("client steps: %lu\n", steps);
+    printf("client requests: %lu\n", NextRequest(dpy) - start_request);
+
+    for (int i = 0; i < n_clients; i++) {
+        XFreeGC(dpy, clients[i].gc);
+        XDestroyWindow(dpy, clients[i].id);
+    }
+    free(clients);
+    XCloseDisplay(dpy);
+
+    return EXIT_SUCCESS;
+}
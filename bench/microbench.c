@@ -0,0 +1,300 @@
+/*
+ * microbenchmarks of axcomp hot paths running against the mock X backend (see mock_x.c)
+ * reports ns/op, heap allocations/op, server resources/op and X requests/op
+ */
+#include "action.h"
+#include "effect.h"
+#include "mock_x.h"
+#include "pool.h"
+#include "render.h"
+#include "scene.h"
+#include "session.h"
+#include "shadow.h"
+#include "stats.h"
+#include "util.h"
+#include "window.h"
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define FIRST_WINDOW 0x400000
+
+struct session s;
+
+static Window *ids;
+static int n_windows = 300;
+static unsigned int seed = 1;
+
+static unsigned int next_random(void) {
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 16) & 0x7fff;
+}
+
+static double get_time_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+typedef struct _bench_state {
+    double start;
+    struct mock_counters counters;
+    unsigned long int request;
+} bench_state;
+
+static void bench_start(bench_state *b) {
+    b->counters = mock;
+    b->request = NextRequest(s.dpy);
+    b->start = get_time_ns();
+}
+
+static void bench_report(bench_state *b, const char *name, unsigned long int ops, double elapsed) {
+    if (elapsed < 0)
+        elapsed = get_time_ns() - b->start;
+    printf("%-24s %10lu %10.1f %11.3f %9.3f %12.3f\n", name, ops, elapsed / ops,
+           (double) (mock.allocations - b->counters.allocations) / ops,
+           (double) (mock.resources - b->counters.resources) / ops,
+           (double) (NextRequest(s.dpy) - b->request) / ops);
+}
+
+static void destroy_windows(void) {
+    while (s.managed_windows)
+        destroy_win(s.managed_windows->id, True);
+    if (s.all_damage) {
+        XFixesDestroyRegion(s.dpy, s.all_damage);
+        s.all_damage = None;
+    }
+}
+
+/*
+ * creates n_windows mapped windows, one in three has an alpha channel
+ * and paints one frame so their regions and pictures exist like in a running session
+ */
+static void create_windows(void) {
+    destroy_windows();
+    for (int i = 0; i < n_windows; i++) {
+        ids[i] = FIRST_WINDOW + i;
+        // sizes come from a few layouts, like tiled or maximized windows sharing their size
+        mock_set_window(ids[i], next_random() % 1600, next_random() % 900,
+                        100 + (next_random() % 6) * 100, 100 + (next_random() % 4) * 100, i % 3 == 0);
+        add_win(ids[i]);
+        map_win(ids[i]);
+    }
+    for (win *w = s.managed_windows; w; w = w->next)
+        w->damaged = True;
+    s.clip_changed = True;
+    scene_paint(None);
+}
+
+static void bench_find_win(unsigned long int ops) {
+    bench_state b;
+    volatile win *found;
+
+    bench_start(&b);
+    for (unsigned long int i = 0; i < ops; i++)
+        found = find_win(ids[next_random() % n_windows], False);
+    (void) found;
+    bench_report(&b, "find_win", ops, -1);
+}
+
+static void bench_restack_win(unsigned long int ops) {
+    bench_state b;
+
+    bench_start(&b);
+    for (unsigned long int i = 0; i < ops; i++) {
+        win *w = find_win(ids[next_random() % n_windows], False);
+        restack_win(w, ids[next_random() % n_windows]);
+    }
+    bench_report(&b, "restack_win", ops, -1);
+}
+
+static void bench_add_damage(unsigned long int ops) {
+    bench_state b;
+    XRectangle r = {0, 0, 64, 64};
+
+    bench_start(&b);
+    for (unsigned long int i = 0; i < ops; i++) {
+        add_damage(region_get(&event_regions, &r, 1));
+        // a frame consumes the accumulated damage every few events
+        if (i % 32 == 31) {
+            region_put(&event_regions, s.all_damage);
+            s.all_damage = None;
+        }
+    }
+    bench_report(&b, "add_damage", ops, -1);
+}
+
+static void bench_damage_win(unsigned long int ops) {
+    bench_state b;
+    XDamageNotifyEvent de = {0};
+
+    bench_start(&b);
+    for (unsigned long int i = 0; i < ops; i++) {
+        de.drawable = ids[next_random() % n_windows];
+        // like handle_event(), every event discards the ignored sequences it has passed
+        de.serial = NextRequest(s.dpy) - 1;
+        discard_ignore(de.serial);
+        damage_win(&de);
+        if (i % 32 == 31) {
+            XFixesDestroyRegion(s.dpy, s.all_damage);
+            s.all_damage = None;
+        }
+    }
+    bench_report(&b, "damage_win", ops, -1);
+}
+
+/*
+ * a painted frame ignores a few sequences per window while events only discard
+ * the sequences they have passed, so the list grows during a frame
+ */
+static void bench_ignore(unsigned long int ops) {
+    bench_state b;
+    unsigned long int calls = 0;
+
+    bench_start(&b);
+    for (unsigned long int i = 0; i < ops; i++) {
+        unsigned long int frame_start = NextRequest(s.dpy);
+        for (int j = 0; j < n_windows * 3; j++) {
+            set_ignore(NextRequest(s.dpy));
+            ((_XPrivDisplay) s.dpy)->request++;
+            calls++;
+            // an event arrives with a serial lagging behind the requests being issued
+            if (j % 64 == 63) {
+                discard_ignore(frame_start + j / 2);
+                calls++;
+            }
+        }
+        discard_ignore(NextRequest(s.dpy));
+        calls++;
+    }
+    bench_report(&b, "set/discard_ignore", calls, -1);
+}
+
+static void bench_paint_all(unsigned long int ops, Bool clip_changed) {
+    bench_state b;
+
+    bench_start(&b);
+    for (unsigned long int i = 0; i < ops; i++) {
+        s.clip_changed = clip_changed;
+        scene_paint(None);
+    }
+    bench_report(&b, clip_changed ? "scene_paint (restack)" : "scene_paint", ops, -1);
+}
+
+/*
+ * paints small damaged rects, the commands of the windows they cross are dropped where they are outside of them
+ * returns the number of dropped commands
+ */
+static unsigned long int bench_paint_damage(unsigned long int ops) {
+    bench_state b;
+    unsigned long int dropped = atomic_load(&stats.dropped_commands);
+
+    bench_start(&b);
+    for (unsigned long int i = 0; i < ops; i++) {
+        XRectangle r = {next_random() % 1600, next_random() % 900, 64, 64};
+        scene_paint(region_get(&event_regions, &r, 1));
+    }
+    bench_report(&b, "scene_paint (damage)", ops, -1);
+
+    dropped = atomic_load(&stats.dropped_commands) - dropped;
+    printf("%-24s %10lu\n", "dropped commands", dropped);
+    return dropped;
+}
+
+static void bench_action_run(unsigned long int ops) {
+    bench_state b;
+    double elapsed = 0;
+
+    effect_table *table = effect_table_new();
+    effect *e = effect_new(table, "bench", "fade", 0.0001);
+    effect_table_swap(table);
+    for (win *w = s.managed_windows; w; w = w->next)
+        action_set(w, e, False, NULL, False, True);
+
+    bench_start(&b);
+    for (unsigned long int i = 0; i < ops; i++) {
+        // wait for the next tick outside of the measured time
+        while (action_timeout() > 0)
+            ;
+        double start = get_time_ns();
+        action_run();
+        elapsed += get_time_ns() - start;
+    }
+    bench_report(&b, "action_run", ops, elapsed);
+
+    for (win *w = s.managed_windows; w; w = w->next)
+        action_cleanup(w);
+}
+
+static void usage(const char *program, Bool failed) {
+    fprintf(stderr, "usage: %s [options]\n%s\n", program,
+            "Options:\n"
+            "   -n count\n"
+            "      Number of windows (default: 300).\n"
+            "   -h help\n"
+            "      Show this message.\n");
+
+    exit(failed ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+int main(int argc, char **argv) {
+    int o;
+    while ((o = getopt(argc, argv, "hn:")) != -1) {
+        switch (o) {
+        case 'h':
+            usage(argv[0], False);
+            break;
+        case 'n':
+            n_windows = atoi(optarg);
+            break;
+        default:
+            usage(argv[0], True);
+            break;
+        }
+    }
+    if (n_windows <= 0)
+        usage(argv[0], True);
+
+    s.dpy = mock_display();
+    s.root = 1;
+    s.root_width = 1920;
+    s.root_height = 1080;
+    s.effect_delta = 1;
+    s.effect_tick = 1;
+    s.render_thread = False;
+    s.shadow_radius = 12;
+    s.shadow_opacity = 0.75;
+    s.wintype_shadows[WINTYPE_NORMAL] = True;
+    shadow_init();
+    s.blur_strength = 3;
+    s.wintype_blurs[WINTYPE_NORMAL] = True;
+    s.wintype_corner_radius[WINTYPE_NORMAL] = 8;
+    scene_init();
+    ids = ecalloc(n_windows, sizeof(Window));
+
+    printf("windows: %i\n", n_windows);
+    printf("%-24s %10s %10s %11s %9s %12s\n", "benchmark", "ops", "ns/op", "allocs/op", "xids/op", "requests/op");
+
+    create_windows();
+    bench_find_win(1000000);
+    bench_restack_win(100000);
+    bench_add_damage(1000000);
+    bench_damage_win(1000000);
+    bench_ignore(1000);
+    bench_paint_all(1000, False);
+    bench_paint_all(1000, True);
+    unsigned long int dropped = bench_paint_damage(1000);
+    bench_action_run(500);
+
+    destroy_windows();
+    free(ids);
+
+    // the commands outside of partial damage must not reach the server
+    if (!dropped) {
+        fprintf(stderr, "no render command was dropped\n");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,514 @@
+/*
+ * minimal in-process replacement of the X libraries used by axcomp
+ * requests only advance the display sequence number, resources are plain counters
+ * so benchmarks measure axcomp's own data structures and not the X server
+ */
+#include "mock_x.h"
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/Xcomposite.h>
+#include <X11/extensions/Xdamage.h>
+#include <X11/extensions/Xfixes.h>
+#include <X11/extensions/Xpresent.h>
+#include <X11/extensions/Xrandr.h>
+#include <X11/extensions/Xrender.h>
+#include <X11/extensions/XShm.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MOCK_WINDOWS 4096 // must be a power of 2
+#define MOCK_REGIONS 4096 // must be a power of 2
+
+struct mock_counters mock;
+
+typedef struct _mock_window {
+    Window id;
+    XWindowAttributes attr;
+} mock_window;
+
+static mock_window windows[MOCK_WINDOWS];
+
+// bounds of the regions last set from rectangles, the regions computed from other regions cover the whole screen
+typedef struct _mock_region {
+    XserverRegion id;
+    int n_rects; // 0 or 1
+    XRectangle bounds;
+} mock_region;
+
+static mock_region regions[MOCK_REGIONS];
+static XID next_xid = 0x200000;
+static Visual visual, argb_visual;
+static XRenderPictFormat format = {.type = PictTypeDirect, .depth = 24};
+static XRenderPictFormat argb_format = {.type = PictTypeDirect, .depth = 32, .direct.alphaMask = 0xff};
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *p, size_t size);
+
+void *__wrap_malloc(size_t size) {
+    mock.allocations++;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t n, size_t size) {
+    mock.allocations++;
+    return __real_calloc(n, size);
+}
+
+void *__wrap_realloc(void *p, size_t size) {
+    mock.allocations++;
+    return __real_realloc(p, size);
+}
+
+static void request(Display *dpy) {
+    ((_XPrivDisplay) dpy)->request++;
+}
+
+static XID resource(Display *dpy) {
+    request(dpy);
+    mock.resources++;
+    return next_xid++;
+}
+
+Display *mock_display(void) {
+    // the private display struct is only partially public, leave room for the rest of it
+    Display *display = __real_calloc(1, 4096);
+
+    // screen macros (DefaultDepth, DefaultVisual, ...) read the screen list
+    Screen *screen = __real_calloc(1, sizeof(Screen));
+    screen->display = display;
+    screen->root = 1;
+    screen->width = 1920;
+    screen->height = 1080;
+    screen->root_depth = 24;
+    screen->root_visual = &visual;
+    ((_XPrivDisplay) display)->screens = screen;
+    ((_XPrivDisplay) display)->nscreens = 1;
+    return display;
+}
+
+static mock_window *mock_find_window(Window id) {
+    unsigned int i = id & (MOCK_WINDOWS - 1);
+    while (windows[i].id && windows[i].id != id)
+        i = (i + 1) & (MOCK_WINDOWS - 1);
+    return &windows[i];
+}
+
+void mock_set_window(Window id, int x, int y, int width, int height, Bool argb) {
+    mock_window *mw = mock_find_window(id);
+    mw->id = id;
+    memset(&mw->attr, 0, sizeof(mw->attr));
+    mw->attr.x = x;
+    mw->attr.y = y;
+    mw->attr.width = width;
+    mw->attr.height = height;
+    mw->attr.depth = argb ? 32 : 24;
+    mw->attr.visual = argb ? &argb_visual : &visual;
+    mw->attr.class = InputOutput;
+    mw->attr.map_state = IsUnmapped;
+}
+
+Status XGetWindowAttributes(Display *dpy, Window id, XWindowAttributes *attr) {
+    request(dpy);
+    mock_window *mw = mock_find_window(id);
+    if (!mw->id)
+        return 0;
+    *attr = mw->attr;
+    return 1;
+}
+
+Atom *XListProperties(Display *dpy, Window id, int *n) {
+    request(dpy);
+    // any non NULL list makes the window its own properties holder
+    static Atom props[1];
+    *n = 1;
+    return props;
+}
+
+Status XQueryTree(Display *dpy, Window id, Window *root, Window *parent, Window **children, unsigned int *n) {
+    request(dpy);
+    *children = NULL;
+    *n = 0;
+    return 1;
+}
+
+int XGetWindowProperty(Display *dpy, Window id, Atom property, long offset, long length, Bool delete, Atom req_type,
+                       Atom *actual_type, int *actual_format, unsigned long *n, unsigned long *left, unsigned char **data) {
+    request(dpy);
+    *actual_type = None;
+    *actual_format = 0;
+    *n = 0;
+    *left = 0;
+    *data = NULL;
+    return Success;
+}
+
+Status XGetTransientForHint(Display *dpy, Window id, Window *transient_for) {
+    request(dpy);
+    return 0;
+}
+
+Status XGetClassHint(Display *dpy, Window id, XClassHint *hint) {
+    request(dpy);
+    return 0;
+}
+
+Status XGetTextProperty(Display *dpy, Window id, XTextProperty *tp, Atom property) {
+    request(dpy);
+    return 0;
+}
+
+int Xutf8TextPropertyToTextList(Display *dpy, const XTextProperty *tp, char ***list, int *n) {
+    *list = NULL;
+    *n = 0;
+    return Success;
+}
+
+void XFreeStringList(char **list) {
+}
+
+int XMapWindow(Display *dpy, Window id) {
+    request(dpy);
+    return 1;
+}
+
+int XUnmapWindow(Display *dpy, Window id) {
+    request(dpy);
+    return 1;
+}
+
+Bool XTranslateCoordinates(Display *dpy, Window src, Window dst, int src_x, int src_y, int *dst_x, int *dst_y,
+                           Window *child) {
+    request(dpy);
+    *dst_x = src_x;
+    *dst_y = src_y;
+    *child = None;
+    return True;
+}
+
+Atom XInternAtom(Display *dpy, _Xconst char *name, Bool only_if_exists) {
+    request(dpy);
+    return next_xid++;
+}
+
+int XFree(void *data) {
+    return 1;
+}
+
+int XSelectInput(Display *dpy, Window id, long mask) {
+    request(dpy);
+    return 1;
+}
+
+int XGetErrorText(Display *dpy, int code, char *buffer, int length) {
+    if (length > 0)
+        buffer[0] = '\0';
+    return 0;
+}
+
+Pixmap XCreatePixmap(Display *dpy, Drawable d, unsigned int width, unsigned int height, unsigned int depth) {
+    return resource(dpy);
+}
+
+int XFreePixmap(Display *dpy, Pixmap pixmap) {
+    request(dpy);
+    return 1;
+}
+
+Pixmap XCompositeNameWindowPixmap(Display *dpy, Window id) {
+    return resource(dpy);
+}
+
+Damage XDamageCreate(Display *dpy, Drawable d, int level) {
+    return resource(dpy);
+}
+
+void XDamageDestroy(Display *dpy, Damage damage) {
+    request(dpy);
+}
+
+void XDamageSubtract(Display *dpy, Damage damage, XserverRegion repair, XserverRegion parts) {
+    request(dpy);
+}
+
+static void mock_set_region(XserverRegion id, XRectangle *rects, int n) {
+    mock_region *r = &regions[id & (MOCK_REGIONS - 1)];
+    r->id = id;
+    r->n_rects = n > 0;
+    if (n <= 0)
+        return;
+    int x2 = rects[0].x + rects[0].width, y2 = rects[0].y + rects[0].height;
+    r->bounds = rects[0];
+    for (int i = 1; i < n; i++) {
+        if (rects[i].x < r->bounds.x)
+            r->bounds.x = rects[i].x;
+        if (rects[i].y < r->bounds.y)
+            r->bounds.y = rects[i].y;
+        if (rects[i].x + rects[i].width > x2)
+            x2 = rects[i].x + rects[i].width;
+        if (rects[i].y + rects[i].height > y2)
+            y2 = rects[i].y + rects[i].height;
+    }
+    r->bounds.width = x2 - r->bounds.x;
+    r->bounds.height = y2 - r->bounds.y;
+}
+
+static void mock_forget_region(XserverRegion id) {
+    mock_region *r = &regions[id & (MOCK_REGIONS - 1)];
+    if (r->id == id)
+        r->id = None;
+}
+
+XserverRegion XFixesCreateRegion(Display *dpy, XRectangle *rectangles, int n) {
+    XserverRegion region = resource(dpy);
+    mock_set_region(region, rectangles, n);
+    return region;
+}
+
+// a region set from rectangles is fetched as their bounds, any other region covers the whole screen
+XRectangle *XFixesFetchRegion(Display *dpy, XserverRegion region, int *n) {
+    static XRectangle fetched[2];
+    static int next = 0;
+
+    request(dpy);
+    mock_region *r = &regions[region & (MOCK_REGIONS - 1)];
+    // the rectangles of the previous fetch may still be in use
+    XRectangle *rect = &fetched[next];
+    next ^= 1;
+    if (r->id != region) {
+        *rect = (XRectangle) {0, 0, 32767, 32767};
+        *n = 1;
+    } else {
+        *rect = r->bounds;
+        *n = r->n_rects;
+    }
+    return rect;
+}
+
+XserverRegion XFixesCreateRegionFromWindow(Display *dpy, Window id, int kind) {
+    return resource(dpy);
+}
+
+void XFixesDestroyRegion(Display *dpy, XserverRegion region) {
+    request(dpy);
+}
+
+void XFixesCopyRegion(Display *dpy, XserverRegion dst, XserverRegion src) {
+    request(dpy);
+    mock_forget_region(dst);
+}
+
+void XFixesSetRegion(Display *dpy, XserverRegion region, XRectangle *rectangles, int nrectangles) {
+    request(dpy);
+    mock_set_region(region, rectangles, nrectangles);
+}
+
+void XFixesUnionRegion(Display *dpy, XserverRegion dst, XserverRegion src1, XserverRegion src2) {
+    request(dpy);
+    mock_forget_region(dst);
+}
+
+void XFixesIntersectRegion(Display *dpy, XserverRegion dst, XserverRegion src1, XserverRegion src2) {
+    request(dpy);
+    mock_forget_region(dst);
+}
+
+void XFixesSubtractRegion(Display *dpy, XserverRegion dst, XserverRegion src1, XserverRegion src2) {
+    request(dpy);
+    mock_forget_region(dst);
+}
+
+void XFixesTranslateRegion(Display *dpy, XserverRegion region, int dx, int dy) {
+    request(dpy);
+    mock_forget_region(region);
+}
+
+void XFixesSetPictureClipRegion(Display *dpy, XID picture, int x, int y, XserverRegion region) {
+    request(dpy);
+}
+
+XRenderPictFormat *XRenderFindVisualFormat(Display *dpy, _Xconst Visual *v) {
+    return v == &argb_visual ? &argb_format : &format;
+}
+
+XRenderPictFormat *XRenderFindStandardFormat(Display *dpy, int format_id) {
+    return format_id == PictStandardA8 ? &argb_format : &format;
+}
+
+Picture XRenderCreatePicture(Display *dpy, Drawable d, _Xconst XRenderPictFormat *format,
+                             unsigned long mask, _Xconst XRenderPictureAttributes *attr) {
+    return resource(dpy);
+}
+
+void XRenderFreePicture(Display *dpy, Picture picture) {
+    request(dpy);
+}
+
+void XRenderComposite(Display *dpy, int op, Picture src, Picture mask, Picture dst, int src_x, int src_y,
+                      int mask_x, int mask_y, int dst_x, int dst_y, unsigned int width, unsigned int height) {
+    request(dpy);
+}
+
+void XRenderFillRectangle(Display *dpy, int op, Picture dst, _Xconst XRenderColor *color,
+                          int x, int y, unsigned int width, unsigned int height) {
+    request(dpy);
+}
+
+void XRenderSetPictureFilter(Display *dpy, Picture picture, const char *filter, XFixed *params, int nparams) {
+    request(dpy);
+}
+
+void XRenderSetPictureTransform(Display *dpy, Picture picture, XTransform *transform) {
+    request(dpy);
+}
+
+Display *XOpenDisplay(_Xconst char *name) {
+    return mock_display();
+}
+
+int XSync(Display *dpy, Bool discard) {
+    request(dpy);
+    return 1;
+}
+
+int XFlush(Display *dpy) {
+    return 1;
+}
+
+Bool XRenderQueryExtension(Display *dpy, int *event, int *error) {
+    return True;
+}
+
+Bool XFixesQueryExtension(Display *dpy, int *event, int *error) {
+    return True;
+}
+
+static int mock_destroy_image(XImage *image) {
+    free(image->data);
+    free(image);
+    return 1;
+}
+
+XImage *XCreateImage(Display *dpy, Visual *v, unsigned int depth, int format, int offset, char *data,
+                     unsigned int width, unsigned int height, int pad, int bytes_per_line) {
+    XImage *image = __real_calloc(1, sizeof(XImage));
+    image->width = width;
+    image->height = height;
+    image->depth = depth;
+    image->format = format;
+    image->data = data;
+    image->bytes_per_line = bytes_per_line;
+    image->f.destroy_image = mock_destroy_image;
+    return image;
+}
+
+int XPutImage(Display *dpy, Drawable d, GC gc, XImage *image, int src_x, int src_y, int dst_x, int dst_y,
+              unsigned int width, unsigned int height) {
+    request(dpy);
+    return 1;
+}
+
+GC XCreateGC(Display *dpy, Drawable d, unsigned long mask, XGCValues *values) {
+    resource(dpy);
+    return NULL;
+}
+
+int XFreeGC(Display *dpy, GC gc) {
+    request(dpy);
+    return 1;
+}
+
+// no RandR, axcomp falls back to a single output covering the root
+Bool XRRQueryExtension(Display *dpy, int *event, int *error) {
+    request(dpy);
+    return False;
+}
+
+void XRRSelectInput(Display *dpy, Window window, int mask) {
+    request(dpy);
+}
+
+XRRScreenResources *XRRGetScreenResourcesCurrent(Display *dpy, Window window) {
+    request(dpy);
+    return NULL;
+}
+
+void XRRFreeScreenResources(XRRScreenResources *resources) {
+}
+
+XRRCrtcInfo *XRRGetCrtcInfo(Display *dpy, XRRScreenResources *resources, RRCrtc crtc) {
+    request(dpy);
+    return NULL;
+}
+
+void XRRFreeCrtcInfo(XRRCrtcInfo *info) {
+}
+
+// no Present, frames are copied to the root picture
+Bool XPresentQueryExtension(Display *dpy, int *major_opcode, int *event, int *error) {
+    request(dpy);
+    return False;
+}
+
+XID XPresentSelectInput(Display *dpy, Window window, unsigned int mask) {
+    request(dpy);
+    return resource(dpy);
+}
+
+void XPresentPixmap(Display *dpy, Window window, Pixmap pixmap, uint32_t serial, XserverRegion valid,
+                    XserverRegion update, int x_off, int y_off, RRCrtc target_crtc, XSyncFence wait_fence,
+                    XSyncFence idle_fence, uint32_t options, uint64_t target_msc, uint64_t divisor,
+                    uint64_t remainder, XPresentNotify *notifies, int nnotifies) {
+    request(dpy);
+}
+
+// no MIT-SHM, frames are not captured
+Bool XShmQueryExtension(Display *dpy) {
+    request(dpy);
+    return False;
+}
+
+XImage *XShmCreateImage(Display *dpy, Visual *v, unsigned int depth, int format, char *data,
+                        XShmSegmentInfo *shminfo, unsigned int width, unsigned int height) {
+    return NULL;
+}
+
+Bool XShmAttach(Display *dpy, XShmSegmentInfo *shminfo) {
+    request(dpy);
+    return False;
+}
+
+Bool XShmDetach(Display *dpy, XShmSegmentInfo *shminfo) {
+    request(dpy);
+    return True;
+}
+
+Bool XShmGetImage(Display *dpy, Drawable d, XImage *image, int x, int y, unsigned long plane_mask) {
+    request(dpy);
+    return False;
+}
+
+Window XCompositeGetOverlayWindow(Display *dpy, Window window) {
+    request(dpy);
+    return resource(dpy);
+}
+
+void XFixesSetWindowShapeRegion(Display *dpy, Window window, int shape_kind, int x_off, int y_off,
+                                XserverRegion region) {
+    request(dpy);
+}
+
+Bool XCheckIfEvent(Display *dpy, XEvent *ev, Bool (*predicate)(Display *, XEvent *, XPointer), XPointer arg) {
+    return False;
+}
+
+int XIfEvent(Display *dpy, XEvent *ev, Bool (*predicate)(Display *, XEvent *, XPointer), XPointer arg) {
+    abort(); // nothing would ever come
+}
+
+Bool XGetEventData(Display *dpy, XGenericEventCookie *cookie) {
+    return False;
+}
+
+void XFreeEventData(Display *dpy, XGenericEventCookie *cookie) {
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <X11/Xlib.h>
+
+/*
+ * counters of the mock X backend used by the microbenchmarks
+ */
+struct mock_counters {
+    unsigned long int allocations; // heap allocations (malloc, calloc, realloc)
+    unsigned long int resources;   // server side resources created (XIDs)
+};
+
+extern struct mock_counters mock;
+
+/*
+ * returns a fake display, the only usable part of it is its request sequence number
+ */
+Display *mock_display(void);
+
+/*
+ * sets the attributes the mock server returns for window id: the given x, y, width and height,
+ * a 32 bits visual with an alpha channel if argb is True and a 24 bits one otherwise, the window is unmapped
+ */
+void mock_set_window(Window id, int x, int y, int width, int height, Bool argb);
@@ -0,0 +1,395 @@
+/*
+ * replays an event stream recorded with 'axcomp -r' against a (headless) X server
+ * every recorded window gets a stand-in window and the recorded events are re-enacted on them
+ * so a running axcomp processes the same sequence of Create/Configure/Damage/Map/... events
+ */
+#include "record.h"
+#include <X11/Xatom.h>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/shape.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#define eprintf(...) (fprintf(stderr, __VA_ARGS__), exit(EXIT_FAILURE))
+
+#define MAP_SIZE 4096 // must be a power of 2
+
+typedef struct _standin {
+    uint32_t recorded; // 0 if slot is empty
+    Window id;
+    GC gc;
+} standin;
+
+static Display *dpy;
+static Window root;
+static Window holder; // parent of stand-ins reparented away from root
+static standin standins[MAP_SIZE];
+static Atom opacity_atom, wintype_atom, winstate_atom;
+static Atom wintype_atoms[NUM_WINTYPES];
+static Atom winstate_atoms[3];
+
+static const char *wintype_atom_names[] = {
+    "_NET_WM_WINDOW_TYPE_DESKTOP", "_NET_WM_WINDOW_TYPE_DOCK", "_NET_WM_WINDOW_TYPE_TOOLBAR",
+    "_NET_WM_WINDOW_TYPE_MENU", "_NET_WM_WINDOW_TYPE_UTILITY", "_NET_WM_WINDOW_TYPE_SPLASH",
+    "_NET_WM_WINDOW_TYPE_DIALOG", "_NET_WM_WINDOW_TYPE_DROPDOWN_MENU", "_NET_WM_WINDOW_TYPE_POPUP_MENU",
+    "_NET_WM_WINDOW_TYPE_TOOLTIP", "_NET_WM_WINDOW_TYPE_NOTIFICATION", "_NET_WM_WINDOW_TYPE_COMBO",
+    "_NET_WM_WINDOW_TYPE_DND", "_NET_WM_WINDOW_TYPE_NORMAL"};
+
+static const size_t payload_sizes[NUM_RECORD_KINDS] = {
+    [RECORD_CREATE] = sizeof(record_create),
+    [RECORD_CONFIGURE] = sizeof(record_configure),
+    [RECORD_DESTROY] = sizeof(record_window),
+    [RECORD_MAP] = sizeof(record_map),
+    [RECORD_UNMAP] = sizeof(record_window),
+    [RECORD_REPARENT] = sizeof(record_reparent),
+    [RECORD_CIRCULATE] = sizeof(record_circulate),
+    [RECORD_DAMAGE] = sizeof(record_area),
+    [RECORD_SHAPE] = sizeof(record_area),
+    [RECORD_OPACITY] = sizeof(record_value),
+    [RECORD_WINSTATE] = sizeof(record_value)};
+
+static void usage(const char *program, Bool failed) {
+    fprintf(stderr, "usage: %s [options] file\n%s\n", program,
+            "Options:\n"
+            "   -d display\n"
+            "      Specifies which display should be used.\n"
+            "   -f\n"
+            "      Replay as fast as possible instead of at recorded speed.\n"
+            "   -h help\n"
+            "      Show this message.\n");
+
+    exit(failed ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+static double get_time(void) {
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+/*
+ * returns the slot of the recorded window, or the empty slot where it should be inserted
+ */
+static standin *standin_slot(uint32_t recorded) {
+    unsigned int i = (recorded * 2654435761U) & (MAP_SIZE - 1);
+    while (standins[i].recorded && standins[i].recorded != recorded)
+        i = (i + 1) & (MAP_SIZE - 1);
+    return &standins[i];
+}
+
+static standin *standin_find(uint32_t recorded) {
+    standin *st = standin_slot(recorded);
+    return st->recorded ? st : NULL;
+}
+
+static void standin_remove(standin *st) {
+    // backward shift deletion keeps linear probing chains intact
+    unsigned int i = st - standins;
+    unsigned int j = i;
+    st->recorded = 0;
+    for (;;) {
+        j = (j + 1) & (MAP_SIZE - 1);
+        if (!standins[j].recorded)
+            break;
+        unsigned int k = (standins[j].recorded * 2654435761U) & (MAP_SIZE - 1);
+        if ((j > i && (k <= i || k > j)) || (j < i && (k <= i && k > j))) {
+            standins[i] = standins[j];
+            standins[j].recorded = 0;
+            i = j;
+        }
+    }
+}
+
+static void replay_create(record_create *r) {
+    standin *st = standin_slot(r->window);
+    if (st->recorded) {
+        // window was reparented back to root
+        XMoveResizeWindow(dpy, st->id, r->geometry.x, r->geometry.y, r->geometry.width, r->geometry.height);
+        return;
+    }
+
+    int screen = DefaultScreen(dpy);
+    XSetWindowAttributes attr;
+    unsigned long mask = CWOverrideRedirect;
+    Visual *visual = DefaultVisual(dpy, screen);
+    int depth = DefaultDepth(dpy, screen);
+    unsigned int class = InputOutput;
+    XVisualInfo vinfo;
+
+    attr.override_redirect = r->override_redirect;
+    if (r->depth == 0) {
+        class = InputOnly;
+        depth = 0;
+        visual = CopyFromParent;
+    } else {
+        mask |= CWBackPixel | CWBorderPixel;
+        attr.background_pixel = 0;
+        attr.border_pixel = 0;
+        if (r->depth == 32 && XMatchVisualInfo(dpy, screen, 32, TrueColor, &vinfo)) {
+            visual = vinfo.visual;
+            depth = vinfo.depth;
+            attr.colormap = XCreateColormap(dpy, root, visual, AllocNone);
+            mask |= CWColormap;
+        }
+    }
+
+    st->recorded = r->window;
+    st->id = XCreateWindow(dpy, root, r->geometry.x, r->geometry.y,
+                           r->geometry.width ? r->geometry.width : 1,
+                           r->geometry.height ? r->geometry.height : 1,
+                           r->geometry.border_width, depth, class, visual, mask, &attr);
+    st->gc = class == InputOnly ? None : XCreateGC(dpy, st->id, 0, NULL);
+}
+
+static void replay_configure(record_configure *r) {
+    standin *st = standin_find(r->window);
+    if (!st)
+        return;
+
+    XWindowChanges changes = {
+        .x = r->geometry.x,
+        .y = r->geometry.y,
+        .width = r->geometry.width ? r->geometry.width : 1,
+        .height = r->geometry.height ? r->geometry.height : 1,
+        .border_width = r->geometry.border_width};
+    unsigned int mask = CWX | CWY | CWWidth | CWHeight | CWBorderWidth | CWStackMode;
+
+    // 'above' is the sibling just below the window, None means the window is at the bottom
+    standin *sibling = r->above ? standin_find(r->above) : NULL;
+    if (sibling) {
+        changes.sibling = sibling->id;
+        changes.stack_mode = Above;
+        mask |= CWSibling;
+    } else if (!r->above) {
+        changes.stack_mode = Below;
+    } else {
+        mask &= ~CWStackMode;
+    }
+    XConfigureWindow(dpy, st->id, mask, &changes);
+}
+
+static void replay_destroy(record_window *r) {
+    standin *st = standin_find(r->window);
+    if (!st)
+        return;
+    if (st->gc)
+        XFreeGC(dpy, st->gc);
+    XDestroyWindow(dpy, st->id);
+    standin_remove(st);
+}
+
+static void replay_map(record_map *r) {
+    standin *st = standin_find(r->window);
+    if (!st)
+        return;
+    // the type must be set before mapping since axcomp reads it when the window is first mapped
+    if (r->window_type < NUM_WINTYPES)
+        XChangeProperty(dpy, st->id, wintype_atom, XA_ATOM, 32, PropModeReplace,
+                        (unsigned char *) &wintype_atoms[r->window_type], 1);
+    XMapWindow(dpy, st->id);
+}
+
+static void replay_unmap(record_window *r) {
+    standin *st = standin_find(r->window);
+    if (st)
+        XUnmapWindow(dpy, st->id);
+}
+
+static void replay_reparent(record_reparent *r) {
+    standin *st = standin_find(r->window);
+    if (st)
+        XReparentWindow(dpy, st->id, r->to_root ? root : holder, 0, 0);
+}
+
+static void replay_circulate(record_circulate *r) {
+    standin *st = standin_find(r->window);
+    if (!st)
+        return;
+    if (r->place == PlaceOnTop)
+        XRaiseWindow(dpy, st->id);
+    else
+        XLowerWindow(dpy, st->id);
+}
+
+static void replay_damage(record_area *r) {
+    standin *st = standin_find(r->window);
+    if (!st || !st->gc)
+        return;
+    XSetForeground(dpy, st->gc, (0xFFU << 24) | (rand() & 0xFFFFFF));
+    XFillRectangle(dpy, st->id, st->gc, r->x, r->y, r->width, r->height);
+}
+
+static void replay_shape(record_area *r) {
+    standin *st = standin_find(r->window);
+    if (!st)
+        return;
+    if (r->shaped) {
+        XRectangle rect = {r->x, r->y, r->width, r->height};
+        XShapeCombineRectangles(dpy, st->id, ShapeBounding, 0, 0, &rect, 1, ShapeSet, Unsorted);
+    } else {
+        XShapeCombineMask(dpy, st->id, ShapeBounding, 0, 0, None, ShapeSet);
+    }
+}
+
+static void replay_opacity(record_value *r) {
+    standin *st = standin_find(r->window);
+    if (!st)
+        return;
+    if (r->value == 0xFFFFFFFF) {
+        XDeleteProperty(dpy, st->id, opacity_atom);
+    } else {
+        unsigned long value = r->value;
+        XChangeProperty(dpy, st->id, opacity_atom, XA_CARDINAL, 32, PropModeReplace, (unsigned char *) &value, 1);
+    }
+}
+
+static void replay_winstate(record_value *r) {
+    standin *st = standin_find(r->window);
+    if (!st)
+        return;
+    Atom atoms[3];
+    int n = 0;
+    // winstate values are bit positions, see WIN_SET_STATE
+    if ((r->value >> WINSTATE_MAXIMIZED_VERT) & 1U)
+        atoms[n++] = winstate_atoms[0];
+    if ((r->value >> WINSTATE_MAXIMIZED_HORZ) & 1U)
+        atoms[n++] = winstate_atoms[1];
+    if ((r->value >> WINSTATE_FULLSCREEN) & 1U)
+        atoms[n++] = winstate_atoms[2];
+    XChangeProperty(dpy, st->id, winstate_atom, XA_ATOM, 32, PropModeReplace, (unsigned char *) atoms, n);
+}
+
+static void replay(record_kind kind, void *payload) {
+    switch (kind) {
+    case RECORD_CREATE:
+        replay_create(payload);
+        break;
+    case RECORD_CONFIGURE:
+        replay_configure(payload);
+        break;
+    case RECORD_DESTROY:
+        replay_destroy(payload);
+        break;
+    case RECORD_MAP:
+        replay_map(payload);
+        break;
+    case RECORD_UNMAP:
+        replay_unmap(payload);
+        break;
+    case RECORD_REPARENT:
+        replay_reparent(payload);
+        break;
+    case RECORD_CIRCULATE:
+        replay_circulate(payload);
+        break;
+    case RECORD_DAMAGE:
+        replay_damage(payload);
+        break;
+    case RECORD_SHAPE:
+        replay_shape(payload);
+        break;
+    case RECORD_OPACITY:
+        replay_opacity(payload);
+        break;
+    case RECORD_WINSTATE:
+        replay_winstate(payload);
+        break;
+    default:
+        break;
+    }
+}
+
+int main(int argc, char **argv) {
+    char *display = NULL;
+    Bool fast = False;
+    int o;
+
+    while ((o = getopt(argc, argv, "hd:f")) != -1) {
+        switch (o) {
+        case 'h':
+            usage(argv[0], False);
+            break;
+        case 'd':
+            display = optarg;
+            break;
+        case 'f':
+            fast = True;
+            break;
+        default:
+            usage(argv[0], True);
+            break;
+        }
+    }
+    if (optind >= argc)
+        usage(argv[0], True);
+
+    FILE *f = fopen(argv[optind], "rb");
+    if (!f)
+        eprintf("cannot open record file '%s'\n", argv[optind]);
+
+    record_header h;
+    if (fread(&h, sizeof(h), 1, f) != 1 || memcmp(h.magic, RECORD_MAGIC, sizeof(h.magic)) != 0)
+        eprintf("'%s' is not an axcomp recording\n", argv[optind]);
+    if (h.version != RECORD_VERSION)
+        eprintf("unsupported recording version %i\n", h.version);
+
+    dpy = XOpenDisplay(display);
+    if (!dpy)
+        eprintf("cannot open display\n");
+    root = DefaultRootWindow(dpy);
+
+    if (DisplayWidth(dpy, DefaultScreen(dpy)) != h.root_width || DisplayHeight(dpy, DefaultScreen(dpy)) != h.root_height)
+        fprintf(stderr, "warning: recording was made on a %ix%i screen\n", h.root_width, h.root_height);
+
+    opacity_atom = XInternAtom(dpy, "_NET_WM_WINDOW_OPACITY", False);
+    wintype_atom = XInternAtom(dpy, "_NET_WM_WINDOW_TYPE", False);
+    winstate_atom = XInternAtom(dpy, "_NET_WM_STATE", False);
+    XInternAtoms(dpy, (char **) wintype_atom_names, NUM_WINTYPES, False, wintype_atoms);
+    winstate_atoms[0] = XInternAtom(dpy, "_NET_WM_STATE_MAXIMIZED_VERT", False);
+    winstate_atoms[1] = XInternAtom(dpy, "_NET_WM_STATE_MAXIMIZED_HORZ", False);
+    winstate_atoms[2] = XInternAtom(dpy, "_NET_WM_STATE_FULLSCREEN", False);
+
+    XSetWindowAttributes attr = {.override_redirect = True};
+    // never mapped so its children are never viewable, InputOutput since it may hold InputOutput children
+    holder = XCreateWindow(dpy, root, -1, -1, 1, 1, 0, CopyFromParent, InputOutput,
+                           CopyFromParent, CWOverrideRedirect, &attr);
+
+    srand(1);
+
+    unsigned long int records = 0;
+    double start = get_time();
+    double next = start;
+    record_entry e;
+    unsigned char payload[64];
+    while (fread(&e, sizeof(e), 1, f) == 1) {
+        if (e.kind >= NUM_RECORD_KINDS || fread(payload, payload_sizes[e.kind], 1, f) != 1)
+            eprintf("corrupted recording after %lu records\n", records);
+
+        if (!fast) {
+            next += e.delay / 1e6;
+            double delay = next - get_time();
+            if (delay > 0) {
+                XFlush(dpy);
+                usleep(delay * 1e6);
+            }
+        }
+
+        replay(e.kind, payload);
+        records++;
+    }
+    XSync(dpy, False);
+    fclose(f);
+
+    printf("records: %lu\n", records);
+    printf("elapsed: %.3f s\n", get_time() - start);
+
+    XCloseDisplay(dpy);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,44 @@
+#!/bin/bash
+# usage: run_bench.sh axcomp bench_client config [windows] [seconds] [pattern]
+# starts Xvfb, runs axcomp with the given config against it while bench_client drives a synthetic workload
+# then prints the client and compositor statistics
+
+AXCOMP=$1
+CLIENT=$2
+CONFIG=$3
+WINDOWS=${4:-32}
+DURATION=${5:-10}
+PATTERN=${6:-all}
+DISPLAY_NUM=${BENCH_DISPLAY:-:99}
+SCREEN=${BENCH_SCREEN:-1920x1080x24}
+
+if ! command -v Xvfb > /dev/null ; then
+    echo "Xvfb not found" >&2
+    exit 1
+fi
+
+Xvfb $DISPLAY_NUM -screen 0 $SCREEN -nolisten tcp +extension Composite 2> /dev/null &
+XVFB_PID=$!
+trap 'kill $XVFB_PID 2> /dev/null' EXIT
+
+# wait for the server to accept connections
+for i in $(seq 50) ; do
+    xdpyinfo -display $DISPLAY_NUM > /dev/null 2>&1 && break
+    sleep 0.1
+done
+
+STATS=$(mktemp)
+"$AXCOMP" -d $DISPLAY_NUM -c "$CONFIG" -s 2> "$STATS" &
+AXCOMP_PID=$!
+sleep 1
+
+echo "config: $CONFIG"
+echo "pattern: $PATTERN"
+# only measure the workload, not startup
+kill -USR1 $AXCOMP_PID
+"$CLIENT" -d $DISPLAY_NUM -n $WINDOWS -t $DURATION -p $PATTERN
+
+kill -TERM $AXCOMP_PID
+wait $AXCOMP_PID
+cat "$STATS"
+rm -f "$STATS"
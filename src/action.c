@@ -1,8 +1,10 @@
+#include "action.h"
 #include "effect.h"
 #include "session.h"
 #include "util.h"
 #include "window.h"
-#include <sys/time.h>
+
+#define EFFECT_STEP_TIME 10 // milliseconds covered by an effect step when effect-delta is automatic
 
 typedef struct _action {
     struct _action *next;
@@ -18,14 +20,8 @@ typedef struct _action {
 } action;
 
 static action *actions;
-static int effect_time = 0;
-
-static int get_time_in_milliseconds(void) {
-    struct timeval tv;
-
-    gettimeofday(&tv, NULL);
-    return tv.tv_sec * 1000 + tv.tv_usec / 1000;
-}
+static double effect_time = 0; // time of the next tick
+static double last_tick = 0;
 
 static action *action_find(win *w) {
     for (action *a = actions; a; a = a->next) {
@@ -56,8 +52,10 @@ void action_cleanup(win *w) {
 }
 
 static void action_enqueue(action *a) {
-    if (!actions)
-        effect_time = get_time_in_milliseconds() + s.effect_delta;
+    if (!actions) {
+        last_tick = get_time_in_milliseconds();
+        effect_time = last_tick + s.effect_tick;
+    }
     a->next = actions;
     actions = a;
 }
@@ -90,25 +88,50 @@ void action_set(win *w, effect *e, Bool reverse, void (*callback)(win *w, Bool g
     (*a->effect)(w, a->progress, &a->effect_data);
 }
 
+void action_finish(win *w) {
+    action *a = action_find(w);
+    if (!a)
+        return;
+
+    (*a->effect)(w, a->end, &a->effect_data);
+    w->action_running = False;
+    determine_mode(w);
+    // the callback may destroy w
+    action_dequeue(a);
+}
+
+int action_count(void) {
+    int n = 0;
+    for (action *a = actions; a; a = a->next)
+        n++;
+    return n;
+}
+
 int action_timeout(void) {
     if (!actions)
         return -1;
-    int now = get_time_in_milliseconds();
-    int delta = effect_time - now;
-    if (delta < 0)
-        delta = 0;
-    return delta;
+    double delta = effect_time - get_time_in_milliseconds();
+    if (delta <= 0)
+        return 0;
+    return (int) delta + 1;
+}
+
+double action_steps(double now, double *last_tick) {
+    // progress follows the elapsed time so effects last as long whatever the tick rate is
+    double steps = (now - *last_tick) / (s.effect_delta > 0 ? s.effect_delta : EFFECT_STEP_TIME);
+    *last_tick = now;
+    return steps;
 }
 
 void action_run(void) {
-    int now = get_time_in_milliseconds();
+    double now = get_time_in_milliseconds();
     action *next = actions;
-    int steps;
+    double steps;
     Bool need_dequeue;
 
     if (effect_time - now > 0)
         return;
-    steps = 1 + (now - effect_time) / s.effect_delta;
+    steps = action_steps(now, &last_tick);
 
     while (next) {
         action *a = next;
@@ -147,5 +170,5 @@ void action_run(void) {
             w->action_running = False;
         }
     }
-    effect_time = now + s.effect_delta;
+    effect_time = now + s.effect_tick;
 }
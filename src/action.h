@@ -7,6 +7,20 @@ void action_cleanup(win *w);
 
 void action_set(win *w, effect *e, Bool reverse, void (*callback)(win *w, Bool gone), Bool gone, Bool exec_callback);
 
+/*
+ * ends the action of w at once, as if it ran until its end
+ */
+void action_finish(win *w);
+
+// returns the number of running animations
+int action_count(void);
+
 int action_timeout(void);
 
+/*
+ * returns the number of effect steps covered by the time elapsed from *last_tick to now and sets *last_tick to now,
+ * animations that do not run as actions step with it too
+ */
+double action_steps(double now, double *last_tick);
+
 void action_run(void);
@@ -1,4 +1,7 @@
+#include "ipc.h"
+#include "record.h"
 #include "session.h"
+#include "stats.h"
 #include <X11/extensions/Xdamage.h>
 #include <getopt.h>
 #include <stdio.h>
@@ -11,6 +14,12 @@ static void usage(const char *program, Bool failed) {
             "      Specifies which display should be managed.\n"
             "   -c path\n"
             "      Specifies configuration file path.\n"
+            "   -i path\n"
+            "      Control socket path, $XDG_RUNTIME_DIR/axcomp-<display>.sock by default (see src/ipc.h).\n"
+            "   -r path\n"
+            "      Record the X event stream to path (see bench/replay.c).\n"
+            "   -s\n"
+            "      Print frame statistics to stderr on exit (SIGINT or SIGTERM), SIGUSR1 resets them.\n"
             "   -h help\n"
             "      Show this message.\n");
 
@@ -21,7 +30,7 @@ static void usage(const char *program, Bool failed) {
 
 // TODO use shared memory extension for huge performance boost (Xshm)
 
-// TODO features : shadows, fade in fade out, pop in pop out, gnome like maximize/minimize animation, dim inactive
+// TODO features : shadows, fade in fade out, pop in pop out, gnome like maximize/minimize animation
 // dock type windows appear gliding from the side (make funtion to detect wich side the dock is likely to be attached),
 // detection of desktop change for special effects (current desktop var in memory and when a client is managed, we keep in memory its desktop)
 // this only works for ewmh or icccm (check wich one) WMs
@@ -58,9 +67,10 @@ static void usage(const char *program, Bool failed) {
 // remove start and end from actions ? (make it go from 0 to 1 all the time and the effect functions do the rest ?)
 
 int main(int argc, char **argv) {
-    char *display = NULL, *config_path = NULL;
+    char *display = NULL, *config_path = NULL, *record_path = NULL, *ipc_path = NULL;
+    Bool print_stats = False;
     char o;
-    while ((o = getopt(argc, argv, "hd:c:")) != -1) {
+    while ((o = getopt(argc, argv, "hd:c:i:r:s")) != -1) {
         switch (o) {
         case 'h':
             usage(argv[0], False);
@@ -71,15 +81,35 @@ int main(int argc, char **argv) {
         case 'c':
             config_path = optarg;
             break;
+        case 'i':
+            ipc_path = optarg;
+            break;
+        case 'r':
+            record_path = optarg;
+            break;
+        case 's':
+            print_stats = True;
+            break;
         default:
             usage(argv[0], True);
             break;
         }
     }
 
-    session_init(display, config_path);
+    session_init(display, config_path, ipc_path);
+
+    if (record_path && !record_open(record_path)) {
+        ipc_close();
+        return EXIT_FAILURE;
+    }
 
     session_loop();
 
+    record_close();
+    ipc_close();
+
+    if (print_stats)
+        stats_print(stderr);
+
     return EXIT_SUCCESS;
 }
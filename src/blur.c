@@ -0,0 +1,165 @@
+#include "blur.h"
+#include "memory.h"
+#include "pool.h"
+#include "scene.h"
+#include "session.h"
+#include "util.h"
+#include <X11/Xlib.h>
+#include <X11/extensions/Xfixes.h>
+#include <X11/extensions/Xrender.h>
+#include <string.h>
+
+#define BLUR_MAX_LEVELS 6
+#define BLUR_MAX_AGE 300 // frames
+
+typedef struct _blur_entry {
+    Window id;
+    int width, height;
+    int n_levels;
+    Picture levels[BLUR_MAX_LEVELS + 1]; // levels[0] is window sized and holds the blurred background
+    int widths[BLUR_MAX_LEVELS + 1], heights[BLUR_MAX_LEVELS + 1];
+    Bool valid;
+    unsigned long int last_used;
+} blur_entry;
+
+static blur_entry *cache = NULL;
+static int n_cache = 0, size_cache = 0;
+static unsigned long int frame = 0;
+
+// levels of freed entries, windows of a given size tend to come back (menus, tooltips, resized windows)
+static picture_pool levels_pool = {.dpy = &s.render_dpy, .memory = MEMORY_BLUR, .max_pictures = 32};
+
+static void blur_entry_free(blur_entry *e) {
+    for (int i = 0; i <= e->n_levels; i++) {
+        if (e->levels[i])
+            picture_put(&levels_pool, e->levels[i], e->widths[i], e->heights[i]);
+        e->levels[i] = None;
+    }
+    e->id = None;
+    e->n_levels = 0;
+    e->valid = False;
+}
+
+static Picture blur_create_level(int width, int height) {
+    // the transform of a pooled level is set by blur_compute() before it is read
+    Picture picture = picture_get(&levels_pool, width, height);
+    if (picture)
+        return picture;
+
+    XRenderPictureAttributes pa;
+    levels_pool.depth = DefaultDepth(s.render_dpy, s.screen);
+    Pixmap pixmap = XCreatePixmap(s.render_dpy, s.root, width, height, levels_pool.depth);
+
+    // samples outside the window geometry repeat its border pixels
+    pa.repeat = RepeatPad;
+    picture = XRenderCreatePicture(s.render_dpy, pixmap,
+                                   XRenderFindVisualFormat(s.render_dpy, DefaultVisual(s.render_dpy, s.screen)),
+                                   CPRepeat, &pa);
+    XFreePixmap(s.render_dpy, pixmap);
+    XRenderSetPictureFilter(s.render_dpy, picture, FilterBilinear, NULL, 0);
+    memory_add(MEMORY_BLUR, memory_pixmap_bytes(width, height, levels_pool.depth));
+    return picture;
+}
+
+static void blur_entry_alloc(blur_entry *e, Window id, int width, int height) {
+    blur_entry_free(e);
+    e->id = id;
+    e->width = width;
+    e->height = height;
+    e->levels[0] = blur_create_level(width, height);
+    e->widths[0] = width;
+    e->heights[0] = height;
+    for (int i = 1; i <= BLUR_MAX_LEVELS && i <= s.blur_strength; i++) {
+        width = (width + 1) / 2;
+        height = (height + 1) / 2;
+        if (width < 2 || height < 2)
+            break;
+        e->levels[i] = blur_create_level(width, height);
+        e->widths[i] = width;
+        e->heights[i] = height;
+        e->n_levels = i;
+    }
+}
+
+static void set_scale(Picture picture, double scale) {
+    XTransform xform = {{{XDoubleToFixed(scale), XDoubleToFixed(0.0), XDoubleToFixed(0.0)},
+                         {XDoubleToFixed(0.0), XDoubleToFixed(scale), XDoubleToFixed(0.0)},
+                         {XDoubleToFixed(0.0), XDoubleToFixed(0.0), XDoubleToFixed(1.0)}}};
+    XRenderSetPictureTransform(s.render_dpy, picture, &xform);
+}
+
+/*
+ * each downsample step halves the picture with bilinear filtering (a 2x2 average),
+ * upsampling back through the same levels spreads the result smoothly
+ */
+static void blur_compute(blur_entry *e, XRectangle *geometry) {
+    XFixesSetPictureClipRegion(s.render_dpy, s.root_buffer, 0, 0, None);
+    XRenderComposite(s.render_dpy, PictOpSrc, s.root_buffer, None, e->levels[0],
+                     geometry->x, geometry->y, 0, 0, 0, 0, e->width, e->height);
+
+    for (int i = 1; i <= e->n_levels; i++) {
+        set_scale(e->levels[i - 1], 2.0);
+        XRenderComposite(s.render_dpy, PictOpSrc, e->levels[i - 1], None, e->levels[i],
+                         0, 0, 0, 0, 0, 0, e->widths[i], e->heights[i]);
+    }
+    for (int i = e->n_levels; i >= 1; i--) {
+        set_scale(e->levels[i], 0.5);
+        XRenderComposite(s.render_dpy, PictOpSrc, e->levels[i], None, e->levels[i - 1],
+                         0, 0, 0, 0, 0, 0, e->widths[i - 1], e->heights[i - 1]);
+    }
+    set_scale(e->levels[0], 1.0);
+    e->valid = True;
+}
+
+static blur_entry *blur_find(Window id) {
+    for (int i = 0; i < n_cache; i++)
+        if (cache[i].id == id)
+            return &cache[i];
+    return NULL;
+}
+
+void blur_invalidate(Window id) {
+    blur_entry *e = blur_find(id);
+    if (e)
+        e->valid = False;
+}
+
+void blur_touch(Window id) {
+    blur_entry *e = blur_find(id);
+    if (e)
+        e->last_used = frame;
+}
+
+Picture blur_background(scene_win *w, Bool dirty) {
+    blur_entry *e = blur_find(w->id);
+
+    if (!e || e->width != w->geometry.width || e->height != w->geometry.height) {
+        if (!e) {
+            if (n_cache == size_cache)
+                cache = erealloc(cache, (size_cache += 16) * sizeof(blur_entry));
+            e = &cache[n_cache++];
+            memset(e, 0, sizeof(blur_entry));
+        }
+        blur_entry_alloc(e, w->id, w->geometry.width, w->geometry.height);
+    }
+
+    if (dirty || !e->valid)
+        blur_compute(e, &w->geometry);
+    e->last_used = frame;
+    return e->levels[0];
+}
+
+void blur_frame_end(void) {
+    // over the memory budget, only the backgrounds painted by this frame are kept
+    unsigned long int max_age = memory_trim_requested() ? 1 : BLUR_MAX_AGE;
+
+    frame++;
+    for (int i = 0; i < n_cache; i++) {
+        if (frame - cache[i].last_used > max_age) {
+            blur_entry_free(&cache[i]);
+            cache[i--] = cache[--n_cache];
+        }
+    }
+    if (max_age == 1)
+        picture_pool_clear(&levels_pool);
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "scene.h"
+#include <X11/Xlib.h>
+#include <X11/extensions/Xrender.h>
+
+/*
+ * blurred backgrounds of translucent windows, render thread only
+ * the background of a window is blurred from s.root_buffer with a downsample/upsample chain
+ * and cached until the scene reports that what is below the window changed
+ */
+
+/*
+ * forgets the cached background of window id, used for scenes the renderer skipped
+ */
+void blur_invalidate(Window id);
+
+/*
+ * keeps the cached background of window id for a frame that does not paint it
+ */
+void blur_touch(Window id);
+
+/*
+ * returns the blurred background of w, recomputed from s.root_buffer if dirty or not cached
+ * s.root_buffer must hold everything below w in the geometry of w
+ */
+Picture blur_background(scene_win *w, Bool dirty);
+
+/*
+ * frees backgrounds of windows that were not painted for a while
+ */
+void blur_frame_end(void);
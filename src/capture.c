@@ -0,0 +1,157 @@
+#include "capture.h"
+#include "session.h"
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/XShm.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+static XShmSegmentInfo shminfo;
+static XImage *image = NULL; // MIT-SHM image of the whole frame, bands are read by pointing it at their rows
+static capture_header *header = NULL;
+static atomic_int segment_id = -1;
+static Bool unavailable = False; // MIT-SHM cannot be used, capture stays off
+
+static void capture_free(void) {
+    // attached clients keep the segment alive, they see it was replaced
+    header->stale = 1;
+    XShmDetach(s.render_dpy, &shminfo);
+    image->data = NULL;
+    XDestroyImage(image);
+    shmdt(shminfo.shmaddr);
+    image = NULL;
+    header = NULL;
+    atomic_store(&segment_id, -1);
+}
+
+static Bool capture_alloc(int width, int height) {
+    Visual *visual = DefaultVisual(s.render_dpy, s.screen);
+
+    image = XShmCreateImage(s.render_dpy, visual, DefaultDepth(s.render_dpy, s.screen), ZPixmap, NULL,
+                            &shminfo, width, height);
+    if (!image)
+        return False;
+
+    // the image is page aligned after the header
+    size_t offset = (sizeof(capture_header) + 4095) & ~(size_t) 4095;
+    shminfo.shmid = shmget(IPC_PRIVATE, offset + (size_t) image->bytes_per_line * height, IPC_CREAT | 0600);
+    if (shminfo.shmid < 0) {
+        XDestroyImage(image);
+        image = NULL;
+        return False;
+    }
+    shminfo.shmaddr = shmat(shminfo.shmid, NULL, 0);
+    shminfo.readOnly = False;
+    if (shminfo.shmaddr == (char *) -1 || !XShmAttach(s.render_dpy, &shminfo)) {
+        shmctl(shminfo.shmid, IPC_RMID, NULL);
+        XDestroyImage(image);
+        image = NULL;
+        return False;
+    }
+    // the segment is destroyed once the server, axcomp and clients detached it
+    XSync(s.render_dpy, False);
+    shmctl(shminfo.shmid, IPC_RMID, NULL);
+
+    header = (capture_header *) shminfo.shmaddr;
+    memcpy(header->magic, CAPTURE_MAGIC, sizeof(header->magic));
+    header->version = CAPTURE_VERSION;
+    header->width = width;
+    header->height = height;
+    header->stride = image->bytes_per_line;
+    header->depth = image->depth;
+    header->bits_per_pixel = image->bits_per_pixel;
+    header->red_mask = visual->red_mask;
+    header->green_mask = visual->green_mask;
+    header->blue_mask = visual->blue_mask;
+    header->image_offset = offset;
+    image->data = shminfo.shmaddr + offset;
+    atomic_store(&segment_id, shminfo.shmid);
+    return True;
+}
+
+/*
+ * adds the rows [y1, y2) to the sorted and disjoint bands, merging the bands it touches
+ * when there are too many bands, the two closest ones are merged
+ */
+static int add_band(capture_band *bands, int n, int y1, int y2) {
+    int i = 0;
+    while (i < n && bands[i].y + bands[i].height < y1)
+        i++;
+    int j = i;
+    for (; j < n && bands[j].y <= y2; j++) {
+        if (bands[j].y < y1)
+            y1 = bands[j].y;
+        if (bands[j].y + bands[j].height > y2)
+            y2 = bands[j].y + bands[j].height;
+    }
+    memmove(&bands[i + 1], &bands[j], (n - j) * sizeof(capture_band));
+    bands[i] = (capture_band){y1, y2 - y1};
+    n += 1 - (j - i);
+
+    if (n > CAPTURE_MAX_BANDS) {
+        int closest = 0;
+        for (int k = 1; k < n - 1; k++)
+            if (bands[k + 1].y - (bands[k].y + bands[k].height) <
+                bands[closest + 1].y - (bands[closest].y + bands[closest].height))
+                closest = k;
+        bands[closest].height = bands[closest + 1].y + bands[closest + 1].height - bands[closest].y;
+        memmove(&bands[closest + 1], &bands[closest + 2], (n - closest - 2) * sizeof(capture_band));
+        n--;
+    }
+    return n;
+}
+
+void capture_publish(Drawable d, int width, int height, XRectangle *rects, int n_rects) {
+    capture_band bands[CAPTURE_MAX_BANDS + 1];
+    int n = 0;
+
+    if (unavailable)
+        return;
+    if (image && (image->width != width || image->height != height))
+        capture_free();
+    if (!image) {
+        if (!XShmQueryExtension(s.render_dpy) || !capture_alloc(width, height)) {
+            fprintf(stderr, "cannot capture frames, MIT-SHM is not usable\n");
+            unavailable = True;
+            return;
+        }
+        // a new segment starts with the whole frame
+        n = add_band(bands, n, 0, height);
+    }
+
+    for (int i = 0; i < n_rects; i++) {
+        int y1 = rects[i].y < 0 ? 0 : rects[i].y;
+        int y2 = rects[i].y + rects[i].height > height ? height : rects[i].y + rects[i].height;
+        if (y1 < y2)
+            n = add_band(bands, n, y1, y2);
+    }
+    if (!n)
+        return;
+
+    uint64_t sequence = header->sequence + 1;
+    capture_frame *f = &header->frames[sequence % CAPTURE_HISTORY];
+    __atomic_store_n(&header->writing, sequence, __ATOMIC_RELEASE);
+    f->sequence = 0;
+    f->n_bands = n;
+    memcpy(f->bands, bands, n * sizeof(capture_band));
+
+    // full width bands are contiguous in the image, the server writes them in place
+    char *data = image->data;
+    for (int i = 0; i < n; i++) {
+        image->height = bands[i].height;
+        image->data = data + (size_t) bands[i].y * image->bytes_per_line;
+        XShmGetImage(s.render_dpy, d, image, 0, bands[i].y, AllPlanes);
+    }
+    image->height = height;
+    image->data = data;
+
+    f->sequence = sequence;
+    __atomic_store_n(&header->sequence, sequence, __ATOMIC_RELEASE);
+}
+
+int capture_segment(void) {
+    return atomic_load(&segment_id);
+}
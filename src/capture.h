@@ -0,0 +1,60 @@
+#pragma once
+
+#include <X11/Xlib.h>
+#include <stdint.h>
+
+/*
+ * export of the composited frames to capture clients through a System V shared memory segment
+ * the server writes the damaged rows of every frame straight into the segment with MIT-SHM,
+ * clients attach it (its id is given by the 'capture' command of the control socket) and read it in place
+ *
+ * the segment starts with a capture_header, the image follows at header->image_offset
+ * a client keeps the sequence of the last frame it read, reads header->sequence, copies the rows damaged
+ * since its last frame (the whole image if they left the ring) and checks header->writing did not change,
+ * else the frame was being written and it copies again
+ * a segment whose header->stale is set was replaced (the screen was resized), clients ask for the new one
+ * nothing is published while compositing is suspended for an unredirected window
+ */
+
+#define CAPTURE_MAGIC "AXCAP"
+#define CAPTURE_VERSION 1
+#define CAPTURE_HISTORY 16  // frames whose damage is kept in the ring
+#define CAPTURE_MAX_BANDS 8 // damaged row ranges per frame, closer ones are merged first
+
+typedef struct _capture_band {
+    uint16_t y;
+    uint16_t height;
+} capture_band;
+
+typedef struct _capture_frame {
+    uint64_t sequence; // 0 if the slot was never written
+    uint32_t n_bands;
+    capture_band bands[CAPTURE_MAX_BANDS];
+} capture_frame;
+
+typedef struct _capture_header {
+    char magic[6];
+    uint16_t version;
+    uint16_t width;
+    uint16_t height;
+    uint32_t stride; // bytes per row of the image
+    uint8_t depth;
+    uint8_t bits_per_pixel;
+    uint8_t stale;
+    uint32_t red_mask, green_mask, blue_mask;
+    uint32_t image_offset;
+    uint64_t writing;                        // sequence of the frame being written
+    uint64_t sequence;                       // sequence of the last complete frame, frames start at 1
+    capture_frame frames[CAPTURE_HISTORY]; // frames[sequence % CAPTURE_HISTORY]
+} capture_header;
+
+/*
+ * copies the rows of d covered by rects into the segment, creating it at the first frame or when the
+ * size of d changes, render thread only (or the event thread without render thread)
+ */
+void capture_publish(Drawable d, int width, int height, XRectangle *rects, int n_rects);
+
+/*
+ * returns the id of the segment, -1 if no frame was captured yet or capture is not possible
+ */
+int capture_segment(void);
@@ -1,11 +1,27 @@
+#include "config.h"
 #include "effect.h"
+#include "rule.h"
 #include "session.h"
+#include "shadow.h"
 #include "util.h"
 #include "window.h"
 #include <basedir.h>
 #include <confuse.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+// rules of effect-rules applied to windows when their type is known
+typedef struct _wintype_rules {
+    Bool shadows[NUM_WINTYPES];
+    Bool blurs[NUM_WINTYPES];
+    int corner_radius[NUM_WINTYPES];
+    Bool dims[NUM_WINTYPES];
+} wintype_rules;
+
+static const char *config_file = NULL; // NULL if no config file was found, defaults are used
+static int watch_fd = -1;
 
 static int validate_unsigned_int(cfg_t *cfg, cfg_opt_t *opt) {
     int value = cfg_opt_getnint(opt, cfg_opt_size(opt) - 1);
@@ -84,9 +100,10 @@ static const char *config_get_path(const char *config_path) {
     return NULL;
 }
 
-void config_get(const char *config_path) {
-    const char *path = config_get_path(config_path);
-
+/*
+ * returns the parsed config file at path or NULL if it has errors, a missing file gives the defaults
+ */
+static cfg_t *config_parse(const char *path) {
     cfg_opt_t effect_opts[] = {
         CFG_STR("function", NULL, CFGF_NONE),
         CFG_FLOAT("step", 0.03, CFGF_NONE),
@@ -99,38 +116,84 @@ void config_get(const char *config_path) {
         CFG_STR("maximize-effect", NULL, CFGF_NONE),
         CFG_STR("move-effect", NULL, CFGF_NONE),
         CFG_STR("desktop-change-effect", NULL, CFGF_NONE),
+        CFG_BOOL("shadow", cfg_false, CFGF_NONE),
+        CFG_BOOL("blur-background", cfg_false, CFGF_NONE),
+        CFG_INT("corner-radius", 0, CFGF_NONE),
+        CFG_BOOL("dim-inactive", cfg_false, CFGF_NONE),
+        CFG_END()};
+    cfg_opt_t window_opts[] = {
+        CFG_STR("class", NULL, CFGF_NONE),
+        CFG_STR("name", NULL, CFGF_NONE),
+        CFG_STR("role", NULL, CFGF_NONE),
+        CFG_STR("map-effect", NULL, CFGF_NONE),
+        CFG_STR("unmap-effect", NULL, CFGF_NONE),
+        CFG_STR("create-effect", NULL, CFGF_NONE),
+        CFG_STR("destroy-effect", NULL, CFGF_NONE),
+        CFG_STR("maximize-effect", NULL, CFGF_NONE),
+        CFG_STR("move-effect", NULL, CFGF_NONE),
+        CFG_STR("desktop-change-effect", NULL, CFGF_NONE),
+        CFG_FLOAT("opacity", 1.0, CFGF_NODEFAULT),
+        CFG_BOOL("shadow", cfg_false, CFGF_NODEFAULT),
+        CFG_BOOL("unredirect", cfg_false, CFGF_NODEFAULT),
         CFG_END()};
     cfg_opt_t effect_rules_opts[] = {
         CFG_SEC("wintype", wintype_opts, CFGF_TITLE | CFGF_MULTI),
+        CFG_SEC("window", window_opts, CFGF_TITLE | CFGF_MULTI),
         CFG_END()};
     cfg_opt_t opts[] = {
-        CFG_INT("effect-delta", 10, CFGF_NONE),
+        CFG_INT("effect-delta", 0, CFGF_NONE),
+        CFG_BOOL("render-thread", cfg_true, CFGF_NONE),
+        CFG_BOOL("present", cfg_true, CFGF_NONE),
+        CFG_BOOL("capture", cfg_false, CFGF_NONE),
+        CFG_INT("shadow-radius", 12, CFGF_NONE),
+        CFG_FLOAT("shadow-opacity", 0.75, CFGF_NONE),
+        CFG_INT("shadow-offset-x", -15, CFGF_NONE),
+        CFG_INT("shadow-offset-y", -15, CFGF_NONE),
+        CFG_INT("blur-strength", 3, CFGF_NONE),
+        CFG_INT("retain-budget", 0, CFGF_NONE),
+        CFG_INT("memory-budget", 0, CFGF_NONE),
+        CFG_FLOAT("inactive-dim", 0.0, CFGF_NONE),
         CFG_SEC("effect", effect_opts, CFGF_TITLE | CFGF_MULTI),
         CFG_SEC("effect-rules", effect_rules_opts, CFGF_NONE),
         CFG_END()};
-    cfg_t *cfg, *cfg_sec;
-
-    cfg = cfg_init(opts, CFGF_NONE);
+    cfg_t *cfg = cfg_init(opts, CFGF_NONE);
 
     cfg_set_validate_func(cfg, "effect-delta", validate_unsigned_int);
+    cfg_set_validate_func(cfg, "shadow-radius", validate_unsigned_int);
+    cfg_set_validate_func(cfg, "shadow-opacity", validate_unsigned_float);
+    cfg_set_validate_func(cfg, "blur-strength", validate_unsigned_int);
+    cfg_set_validate_func(cfg, "retain-budget", validate_unsigned_int);
+    cfg_set_validate_func(cfg, "memory-budget", validate_unsigned_int);
+    cfg_set_validate_func(cfg, "inactive-dim", validate_unsigned_float);
+    cfg_set_validate_func(cfg, "effect-rules|wintype|corner-radius", validate_unsigned_int);
+    cfg_set_validate_func(cfg, "effect-rules|window|opacity", validate_unsigned_float);
     cfg_set_validate_func(cfg, "effect|step", validate_unsigned_float);
     cfg_set_validate_func(cfg, "effect|function", validate_effect_function);
 
-    if (cfg_parse(cfg, path) == CFG_PARSE_ERROR)
-        exit(EXIT_FAILURE);
+    if (path && cfg_parse(cfg, path) == CFG_PARSE_ERROR) {
+        cfg_free(cfg);
+        return NULL;
+    }
+    return cfg;
+}
 
-    s.effect_delta = cfg_getint(cfg, "effect-delta");
+/*
+ * builds the effects and effect rules of cfg into table and rules, returns False if they are not valid
+ */
+static Bool config_get_effects(cfg_t *cfg, effect_table *table, wintype_rules *rules) {
+    cfg_t *cfg_sec;
 
     for (int i = 0; i < cfg_size(cfg, "effect"); i++) {
         cfg_sec = cfg_getnsec(cfg, "effect", i);
 
         char *effect_function = cfg_getstr(cfg_sec, "function");
-        if (!effect_function) // TODO put conf file path in error msg
-            eprintf("(TODO conf file path here): option 'function' must be set in section 'effect %s'\n", cfg_title(cfg_sec));
-
-        effect_new(cfg_title(cfg_sec), effect_function, cfg_getfloat(cfg_sec, "step"));
+        if (!effect_function) {
+            fprintf(stderr, "%s: option 'function' must be set in section 'effect %s'\n",
+                    config_file, cfg_title(cfg_sec));
+            return False;
+        }
 
-        free(effect_function);
+        effect_new(table, cfg_title(cfg_sec), effect_function, cfg_getfloat(cfg_sec, "step"));
     }
 
     for (int i = 0; i < cfg_size(cfg, "effect-rules|wintype"); i++) {
@@ -138,20 +201,193 @@ void config_get(const char *config_path) {
 
         const char *wintype_name = cfg_title(cfg_sec);
         wintype window_type = get_wintype_from_name(wintype_name);
-        if (window_type == WINTYPE_UNKNOWN) // TODO put conf file path in error msg
-            eprintf("(TODO conf file path here): wrong wintype '%s' in section 'effect-rules'\n", wintype_name);
+        if (window_type == WINTYPE_UNKNOWN) {
+            fprintf(stderr, "%s: wrong wintype '%s' in section 'effect-rules'\n", config_file, wintype_name);
+            return False;
+        }
+
+        rules->shadows[window_type] = cfg_getbool(cfg_sec, "shadow");
+        rules->blurs[window_type] = cfg_getbool(cfg_sec, "blur-background");
+        rules->corner_radius[window_type] = cfg_getint(cfg_sec, "corner-radius");
+        rules->dims[window_type] = cfg_getbool(cfg_sec, "dim-inactive");
 
         for (int j = 0; j < NUM_EVENT_EFFECTS; j++) {
             char *effect_name = cfg_getstr(cfg_sec, get_event_effect_name(j));
             if (!effect_name)
                 continue;
-            effect *e = effect_find(effect_name);
-            if (!e) // TODO put conf file path in error msg
-                eprintf("(TODO conf file path here): effect '%s' in section 'wintype %s' is not defined\n",
-                        effect_name, wintype_name);
-            effect_set(window_type, j, e);
-            free(effect_name);
+            effect *e = effect_find(table, effect_name);
+            if (!e) {
+                fprintf(stderr, "%s: effect '%s' in section 'wintype %s' is not defined\n",
+                        config_file, effect_name, wintype_name);
+                return False;
+            }
+            effect_set(table, window_type, j, e);
+        }
+    }
+
+    for (int i = 0; i < cfg_size(cfg, "effect-rules|window"); i++) {
+        cfg_sec = cfg_getnsec(cfg, "effect-rules|window", i);
+
+        const char *title = cfg_title(cfg_sec);
+        window_rule *rule = rule_add(table->rules, title, cfg_getstr(cfg_sec, "class"),
+                                     cfg_getstr(cfg_sec, "name"), cfg_getstr(cfg_sec, "role"));
+        if (!rule) {
+            fprintf(stderr, "%s: option 'name' in section 'window %s' is not a valid regular expression\n",
+                    config_file, title);
+            return False;
+        }
+
+        for (int j = 0; j < NUM_EVENT_EFFECTS; j++) {
+            char *effect_name = cfg_getstr(cfg_sec, get_event_effect_name(j));
+            if (!effect_name)
+                continue;
+            rule->effects[j] = effect_find(table, effect_name);
+            if (!rule->effects[j]) {
+                fprintf(stderr, "%s: effect '%s' in section 'window %s' is not defined\n",
+                        config_file, effect_name, title);
+                return False;
+            }
+        }
+
+        // options missing from the section keep the values of the window type
+        if (cfg_size(cfg_sec, "opacity")) {
+            rule->opacity = cfg_getfloat(cfg_sec, "opacity");
+            if (rule->opacity > 1.0)
+                rule->opacity = 1.0;
+        }
+        if (cfg_size(cfg_sec, "shadow"))
+            rule->shadow = cfg_getbool(cfg_sec, "shadow");
+        if (cfg_size(cfg_sec, "unredirect"))
+            rule->unredirect = cfg_getbool(cfg_sec, "unredirect");
+    }
+    return True;
+}
+
+static void config_set_effects(cfg_t *cfg, effect_table *table, wintype_rules *rules) {
+    s.inactive_dim = cfg_getfloat(cfg, "inactive-dim");
+    if (s.inactive_dim > 1.0)
+        s.inactive_dim = 1.0;
+
+    memcpy(s.wintype_shadows, rules->shadows, sizeof(s.wintype_shadows));
+    memcpy(s.wintype_blurs, rules->blurs, sizeof(s.wintype_blurs));
+    memcpy(s.wintype_corner_radius, rules->corner_radius, sizeof(s.wintype_corner_radius));
+    memcpy(s.wintype_dims, rules->dims, sizeof(s.wintype_dims));
+    effect_table_swap(table);
+}
+
+Bool config_get(const char *config_path) {
+    config_file = config_get_path(config_path);
+
+    cfg_t *cfg = config_parse(config_file);
+    if (!cfg)
+        return False;
+
+    effect_table *table = effect_table_new();
+    wintype_rules rules = {0};
+    if (!config_get_effects(cfg, table, &rules)) {
+        effect_table_free(table);
+        cfg_free(cfg);
+        return False;
+    }
+
+    s.effect_delta = cfg_getint(cfg, "effect-delta");
+    s.render_thread = cfg_getbool(cfg, "render-thread");
+    s.present = cfg_getbool(cfg, "present");
+    s.capture = cfg_getbool(cfg, "capture");
+
+    s.shadow_radius = cfg_getint(cfg, "shadow-radius");
+    s.shadow_opacity = cfg_getfloat(cfg, "shadow-opacity");
+    if (s.shadow_opacity > 1.0)
+        s.shadow_opacity = 1.0;
+    s.shadow_offset_x = cfg_getint(cfg, "shadow-offset-x");
+    s.shadow_offset_y = cfg_getint(cfg, "shadow-offset-y");
+    shadow_init();
+
+    s.blur_strength = cfg_getint(cfg, "blur-strength");
+    s.retain_budget = (unsigned long int) cfg_getint(cfg, "retain-budget") * 1024 * 1024;
+    s.memory_budget = (unsigned long int) cfg_getint(cfg, "memory-budget") * 1024 * 1024;
+
+    config_set_effects(cfg, table, &rules);
+    cfg_free(cfg);
+    return True;
+}
+
+/*
+ * the file is parsed on the event thread: it only happens when the file is saved and the time it takes is
+ * logged, the effect table and the rules are only used by the event thread which would have to swap them
+ * anyway, and the scenes already queued keep being painted by the render thread meanwhile
+ */
+Bool config_reload(void) {
+    double start = get_time_in_milliseconds();
+
+    // an editor replacing the file may not have moved the new one in place yet
+    if (!file_exists(config_file)) {
+        fprintf(stderr, "%s: cannot be read, keeping the current configuration\n", config_file);
+        return False;
+    }
+
+    cfg_t *cfg = config_parse(config_file);
+    effect_table *table = effect_table_new();
+    wintype_rules rules = {0};
+    if (!cfg || !config_get_effects(cfg, table, &rules)) {
+        effect_table_free(table);
+        if (cfg)
+            cfg_free(cfg);
+        fprintf(stderr, "%s: not reloaded because of errors, keeping the current configuration\n", config_file);
+        return False;
+    }
+
+    int effect_delta = cfg_getint(cfg, "effect-delta");
+    if (effect_delta != s.effect_delta) {
+        s.effect_delta = effect_delta;
+        output_update_tick();
+    }
+    config_set_effects(cfg, table, &rules);
+    cfg_free(cfg);
+
+    fprintf(stderr, "%s: reloaded in %.2f ms\n", config_file, get_time_in_milliseconds() - start);
+    return True;
+}
+
+// the directory is watched because editors often replace the file instead of writing to it
+int config_watch(void) {
+    if (!config_file)
+        return -1;
+
+    watch_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (watch_fd < 0) {
+        fprintf(stderr, "%s: cannot watch for changes\n", config_file);
+        return -1;
+    }
+
+    char *dir = strdup(config_file);
+    char *slash = strrchr(dir, '/');
+    if (slash)
+        slash[slash == dir ? 1 : 0] = '\0';
+    if (inotify_add_watch(watch_fd, slash ? dir : ".", IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        fprintf(stderr, "%s: cannot watch for changes\n", config_file);
+        close(watch_fd);
+        watch_fd = -1;
+    }
+    free(dir);
+    return watch_fd;
+}
+
+Bool config_changed(void) {
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    const char *slash = strrchr(config_file, '/');
+    const char *name = slash ? slash + 1 : config_file;
+    Bool changed = False;
+    ssize_t len;
+
+    // every pending event is consumed, a save made of several writes and renames reloads once
+    while ((len = read(watch_fd, buf, sizeof(buf))) > 0) {
+        for (char *p = buf; p < buf + len;) {
+            struct inotify_event *ev = (struct inotify_event *) p;
+            if (ev->len && strcmp(ev->name, name) == 0)
+                changed = True;
+            p += sizeof(struct inotify_event) + ev->len;
         }
-        free((void *) wintype_name);
     }
+    return changed;
 }
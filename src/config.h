@@ -1,3 +1,24 @@
 #pragma once
 
-void config_get(const char *config_path);
+#include <X11/Xlib.h>
+
+/*
+ * reads every option from the config file, returns False if it has errors
+ */
+Bool config_get(const char *config_path);
+
+/*
+ * reads the config file again and applies effect-delta, inactive-dim, effects and effect-rules,
+ * the other options need a restart, returns False and keeps the current config if it has errors
+ */
+Bool config_reload(void);
+
+/*
+ * returns a file descriptor readable when the config file may have changed, -1 if it cannot be watched
+ */
+int config_watch(void);
+
+/*
+ * consumes the watch events, returns True if one of them was about the config file
+ */
+Bool config_changed(void);
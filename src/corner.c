@@ -0,0 +1,148 @@
+#include "corner.h"
+#include "memory.h"
+#include "pool.h"
+#include "session.h"
+#include "util.h"
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/Xrender.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#define CORNER_CACHE_SIZE 32
+#define CORNER_SAMPLES 4 // per pixel and per axis
+
+typedef struct _corner_entry {
+    int radius;
+    Picture picture;
+    unsigned long int last_used;
+} corner_entry;
+
+// a disk scaled by the alpha of a window opacity for the current frame
+typedef struct _scaled_mask {
+    int radius;
+    Picture alpha;
+    Picture picture;
+} scaled_mask;
+
+static corner_entry cache[CORNER_CACHE_SIZE];
+static unsigned long int cache_clock = 0;
+
+// pictures evicted while the frame may still use them, freed once it is submitted
+static Picture *evicted = NULL;
+static int n_evicted = 0, size_evicted = 0;
+static unsigned long int evicted_bytes = 0;
+
+static scaled_mask *scaled = NULL;
+static int n_scaled = 0, size_scaled = 0;
+static picture_pool scaled_pool = {.dpy = &s.render_dpy, .memory = MEMORY_MASKS, .depth = 8, .max_pictures = 16};
+
+static Picture corner_build(int radius) {
+    int size = radius * 2;
+    // rows are padded to 32 bits for XPutImage
+    int stride = (size + 3) & ~3;
+    uint8_t *data = ecalloc(stride, size);
+    double r2 = (double) radius * radius;
+
+    for (int y = 0; y < size; y++) {
+        for (int x = 0; x < size; x++) {
+            int covered = 0;
+            for (int sy = 0; sy < CORNER_SAMPLES; sy++) {
+                double dy = y + (sy + 0.5) / CORNER_SAMPLES - radius;
+                for (int sx = 0; sx < CORNER_SAMPLES; sx++) {
+                    double dx = x + (sx + 0.5) / CORNER_SAMPLES - radius;
+                    covered += dx * dx + dy * dy <= r2;
+                }
+            }
+            data[y * stride + x] = covered * 0xff / (CORNER_SAMPLES * CORNER_SAMPLES);
+        }
+    }
+
+    XImage *image = XCreateImage(s.render_dpy, DefaultVisual(s.render_dpy, s.screen), 8, ZPixmap, 0,
+                                 (char *) data, size, size, 32, stride);
+    if (!image) {
+        free(data);
+        return None;
+    }
+
+    Pixmap pixmap = XCreatePixmap(s.render_dpy, s.root, size, size, 8);
+    GC gc = XCreateGC(s.render_dpy, pixmap, 0, NULL);
+    XPutImage(s.render_dpy, pixmap, gc, image, 0, 0, 0, 0, size, size);
+    XFreeGC(s.render_dpy, gc);
+    XDestroyImage(image); // frees data
+
+    Picture picture = XRenderCreatePicture(s.render_dpy, pixmap,
+                                           XRenderFindStandardFormat(s.render_dpy, PictStandardA8),
+                                           0, NULL);
+    XFreePixmap(s.render_dpy, pixmap);
+    return picture;
+}
+
+static Picture corner_disk(int radius) {
+    corner_entry *lru = &cache[0];
+    cache_clock++;
+    for (int i = 0; i < CORNER_CACHE_SIZE; i++) {
+        corner_entry *e = &cache[i];
+        if (e->picture && e->radius == radius) {
+            e->last_used = cache_clock;
+            return e->picture;
+        }
+        if (e->last_used < lru->last_used)
+            lru = e;
+    }
+
+    if (lru->picture) {
+        if (n_evicted == size_evicted)
+            evicted = erealloc(evicted, (size_evicted += 16) * sizeof(Picture));
+        evicted[n_evicted++] = lru->picture;
+        evicted_bytes += memory_pixmap_bytes(lru->radius * 2, lru->radius * 2, 8);
+    }
+    lru->radius = radius;
+    lru->picture = corner_build(radius);
+    if (lru->picture)
+        memory_add(MEMORY_MASKS, memory_pixmap_bytes(radius * 2, radius * 2, 8));
+    lru->last_used = cache_clock;
+    return lru->picture;
+}
+
+Picture corner_mask(int radius, Picture alpha) {
+    Picture disk = corner_disk(radius);
+    if (!disk || !alpha)
+        return disk;
+
+    for (int i = 0; i < n_scaled; i++)
+        if (scaled[i].radius == radius && scaled[i].alpha == alpha)
+            return scaled[i].picture;
+
+    // the disk is multiplied by the alpha of the 1x1 picture instead of being rasterized again for each opacity
+    int size = radius * 2;
+    Picture picture = picture_get(&scaled_pool, size, size);
+    if (!picture) {
+        Pixmap pixmap = XCreatePixmap(s.render_dpy, s.root, size, size, 8);
+        picture = XRenderCreatePicture(s.render_dpy, pixmap, XRenderFindStandardFormat(s.render_dpy, PictStandardA8),
+                                       0, NULL);
+        XFreePixmap(s.render_dpy, pixmap);
+        memory_add(MEMORY_MASKS, memory_pixmap_bytes(size, size, 8));
+    }
+    XRenderComposite(s.render_dpy, PictOpSrc, disk, alpha, picture, 0, 0, 0, 0, 0, 0, size, size);
+
+    if (n_scaled == size_scaled)
+        scaled = erealloc(scaled, (size_scaled += 16) * sizeof(scaled_mask));
+    scaled[n_scaled].radius = radius;
+    scaled[n_scaled].alpha = alpha;
+    scaled[n_scaled].picture = picture;
+    n_scaled++;
+    return picture;
+}
+
+void corner_frame_end(void) {
+    for (int i = 0; i < n_scaled; i++)
+        picture_put(&scaled_pool, scaled[i].picture, scaled[i].radius * 2, scaled[i].radius * 2);
+    n_scaled = 0;
+
+    for (int i = 0; i < n_evicted; i++)
+        XRenderFreePicture(s.render_dpy, evicted[i]);
+    n_evicted = 0;
+    memory_add(MEMORY_MASKS, -(long int) evicted_bytes);
+    evicted_bytes = 0;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <X11/Xlib.h>
+#include <X11/extensions/Xrender.h>
+
+/*
+ * returns the A8 mask of an antialiased disk of the given radius, multiplied by the 1x1 repeating picture alpha
+ * unless it is None
+ * the mask covers (2 * radius) x (2 * radius) pixels, each quarter is the mask of one corner
+ * of a rounded window so it is shared by windows of all sizes
+ * disks are cached by radius and owned by the cache, the masks of an alpha are made from them for a frame,
+ * render thread only
+ * a picture stays valid until the end of the frame it was returned for
+ */
+Picture corner_mask(int radius, Picture alpha);
+
+/*
+ * frees the pictures evicted from the cache during the frame and gives back its masks of an alpha,
+ * once its commands are submitted
+ */
+void corner_frame_end(void);
@@ -0,0 +1,122 @@
+#include "desktop.h"
+#include "action.h"
+#include "effect.h"
+#include "pool.h"
+#include "render.h"
+#include "session.h"
+#include "util.h"
+#include <X11/Xatom.h>
+#include <X11/Xlib.h>
+
+static desktop_transition transition;
+static double step; // progress made by an effect step
+static double effect_time = 0; // time of the next tick
+static double last_tick = 0;
+
+/*
+ * returns the CARDINAL property of id, -1 if it is not set
+ */
+static long get_cardinal_prop(Window id, Atom property) {
+    Atom actual;
+    int format;
+    unsigned long n, left;
+    unsigned char *data;
+
+    set_ignore(NextRequest(s.dpy));
+    int result = XGetWindowProperty(s.dpy, id, property, 0L, 1L, False, XA_CARDINAL, &actual, &format,
+                                    &n, &left, &data);
+    if (result != Success || !data)
+        return -1;
+    long value = n == 1 && format == 32 ? (long) (*(unsigned long *) data & 0xFFFFFFFF) : -1;
+    XFree(data);
+    return value;
+}
+
+/*
+ * damages a pixel of every output, the renderer repaints the whole screen while a switch runs
+ * but a frame is only painted when there is damage
+ */
+static void damage_outputs(void) {
+    for (int i = 0; i < s.n_outputs; i++) {
+        XRectangle r = {s.outputs[i].geometry.x, s.outputs[i].geometry.y, 1, 1};
+        add_damage(region_get(&event_regions, &r, 1));
+    }
+}
+
+void desktop_init(void) {
+    s.current_desktop = get_cardinal_prop(s.root, s.current_desktop_atom);
+}
+
+void determine_desktop(win *w) {
+    w->desktop = get_cardinal_prop(w->props_window_id, s.wm_desktop_atom);
+}
+
+void desktop_changed(void) {
+    long previous = s.current_desktop;
+    s.current_desktop = get_cardinal_prop(s.root, s.current_desktop_atom);
+    if (s.current_desktop == previous || previous < 0 || s.current_desktop < 0 || s.unredirected)
+        return;
+
+    effect *e = effect_get_desktop_change();
+    if (!e)
+        return;
+
+    // the last frame shows the outgoing desktop as it was, the windows the window manager already
+    // mapped or unmapped for the switch are shown as they will be
+    for (win *w = s.managed_windows; w;) {
+        win *next = w->next; // finishing an unmap of a destroyed window frees it
+        if (w->action_running && desktop_switching(w))
+            action_finish(w);
+        w = next;
+    }
+
+    transition.running = True;
+    transition.start = True;
+    transition.progress = 0.0;
+    effect_slide_direction(e->func, s.current_desktop > previous, &transition.dx, &transition.dy);
+    step = e->step;
+    last_tick = get_time_in_milliseconds();
+    effect_time = last_tick + s.effect_tick;
+
+    // the incoming snapshot is painted entirely once
+    XRectangle r = {0, 0, s.root_width, s.root_height};
+    add_damage(region_get(&event_regions, &r, 1));
+}
+
+Bool desktop_switching(win *w) {
+    // windows shown on every desktop and override redirect windows are not part of a desktop
+    return transition.running && w->desktop >= 0 && w->desktop != DESKTOP_ALL;
+}
+
+int desktop_timeout(void) {
+    if (!transition.running)
+        return -1;
+    double delta = effect_time - get_time_in_milliseconds();
+    if (delta <= 0)
+        return 0;
+    return (int) delta + 1;
+}
+
+void desktop_run(void) {
+    double now = get_time_in_milliseconds();
+
+    if (!transition.running || effect_time - now > 0)
+        return;
+    transition.progress += step * action_steps(now, &last_tick);
+    effect_time = now + s.effect_tick;
+
+    if (transition.progress < 1.0) {
+        damage_outputs();
+        return;
+    }
+
+    // the screen is painted from the windows again, the buffers still hold the last step
+    transition.running = False;
+    XRectangle r = {0, 0, s.root_width, s.root_height};
+    add_damage(region_get(&event_regions, &r, 1));
+}
+
+void desktop_scene(desktop_transition *t) {
+    *t = transition;
+    transition.start = False;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "window.h"
+#include <X11/Xlib.h>
+
+/*
+ * desktop switches, seen as a change of _NET_CURRENT_DESKTOP on the root window
+ * a switch is animated by the desktop-change-effect of the normal window type as a whole: the last frame
+ * painted before it is the snapshot of the outgoing desktop, the windows are painted into a second
+ * snapshot (the incoming desktop) as usual and each frame only composites the two snapshots
+ * the slide functions slide the snapshots (slide-auto goes left to a following desktop and right to a
+ * previous one), the others cross-fade them
+ * windows of both desktops are not animated on their own while the switch runs
+ */
+
+// what the renderer needs to paint a desktop switch
+typedef struct _desktop_transition {
+    Bool running;
+    Bool start;      // the last frame painted is the outgoing desktop, the snapshots are made again
+    double progress; // from 0 to 1
+    int dx, dy;      // direction the desktops slide to (-1, 0 or 1), both 0 to cross-fade them
+} desktop_transition;
+
+/*
+ * reads the current desktop from the root window
+ */
+void desktop_init(void);
+
+/*
+ * reads the desktop of w from its property window
+ */
+void determine_desktop(win *w);
+
+/*
+ * starts the animation of a desktop switch after _NET_CURRENT_DESKTOP changed
+ */
+void desktop_changed(void);
+
+/*
+ * returns True if w is shown or hidden by a desktop switch being animated, it is then not animated itself
+ */
+Bool desktop_switching(win *w);
+
+/*
+ * returns the poll timeout until the next step of the desktop switch, -1 if there is none
+ */
+int desktop_timeout(void);
+
+/*
+ * steps the desktop switch if it is due
+ */
+void desktop_run(void);
+
+/*
+ * fills t for the scene being built
+ */
+void desktop_scene(desktop_transition *t);
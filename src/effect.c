@@ -1,4 +1,5 @@
 #include "effect.h"
+#include "rule.h"
 #include "session.h"
 #include "util.h"
 #include "window.h"
@@ -6,8 +7,7 @@
 
 // TODO when an effect is replaced by another, we should clean all effect related variables
 
-static effect *effect_dispatch_table[NUM_WINTYPES][NUM_EVENT_EFFECTS] = {{NULL}};
-static effect *effects;
+static effect_table *current_table = NULL;
 
 static void fade(win *w, double progress, void **effect_data) {
     if (*effect_data == NULL) {
@@ -43,6 +43,10 @@ static void slide_right(win *w, double progress, void **effect_data) {
     w->offset_x = (w->attr.width * progress) - w->attr.width;
 }
 
+// geometry changes are interpolated by src/morph.h, actions using it change nothing
+static void morph(win *w, double progress, void **effect_data) {
+}
+
 // FIXME there is a bug where for a frame slide_right is used instead of slide_down for my awesomewm dock panel
 // happens only at window creation (find a way to correct this and keep it compatible for all cases)
 static void slide_auto(win *w, double progress, void **effect_data) {
@@ -63,12 +67,70 @@ static void slide_auto(win *w, double progress, void **effect_data) {
     }
 }
 
-effect *effect_get(wintype window_type, event_effect event) {
-    return effect_dispatch_table[window_type][event];
+effect *effect_get(win *w, event_effect event) {
+    if (s.effects_paused)
+        return NULL;
+    if (w->rule && w->rule->effects[event])
+        return w->rule->effects[event];
+    if (!current_table || w->window_type >= NUM_WINTYPES)
+        return NULL;
+    return current_table->dispatch[w->window_type][event];
+}
+
+effect *effect_get_desktop_change(void) {
+    if (s.effects_paused || !current_table)
+        return NULL;
+    return current_table->dispatch[WINTYPE_NORMAL][EVENT_DESKTOP_CHANGE];
+}
+
+Bool effect_is_morph(effect *e) {
+    return e->func == morph;
+}
+
+void effect_slide_direction(effect_func func, Bool forward, int *dx, int *dy) {
+    *dx = *dy = 0;
+    // a window sliding left comes in from the right, so does the new desktop
+    if (func == slide_left || (func == slide_auto && forward))
+        *dx = -1;
+    else if (func == slide_right || func == slide_auto)
+        *dx = 1;
+    else if (func == slide_up)
+        *dy = -1;
+    else if (func == slide_down)
+        *dy = 1;
+}
+
+rule_set *effect_rules(void) {
+    return current_table ? current_table->rules : NULL;
 }
 
-void effect_set(wintype window_type, event_effect event, effect *e) {
-    effect_dispatch_table[window_type][event] = e;
+void effect_set(effect_table *table, wintype window_type, event_effect event, effect *e) {
+    table->dispatch[window_type][event] = e;
+}
+
+effect_table *effect_table_new(void) {
+    effect_table *table = ecalloc(1, sizeof(effect_table));
+    table->rules = rule_set_new();
+    return table;
+}
+
+void effect_table_free(effect_table *table) {
+    effect *next;
+    for (effect *e = table->effects; e; e = next) {
+        next = e->next;
+        free(e->name);
+        free(e);
+    }
+    rule_set_free(table->rules);
+    free(table);
+}
+
+void effect_table_swap(effect_table *table) {
+    effect_table *old = current_table;
+    current_table = table;
+    // actions copied the function and step of their effect, windows must match the new rules before the next event
+    if (old)
+        effect_table_free(old);
 }
 
 static const char *event_effect_names[] = {"map-effect", "unmap-effect", "create-effect", "destroy-effect",
@@ -79,8 +141,9 @@ const char *get_event_effect_name(event_effect effect) {
     return event_effect_names[effect];
 }
 
-static const effect_func effect_funcs[] = {fade, pop, slide_auto, slide_up, slide_down, slide_left, slide_right};
-static const char *effect_funcs_names[] = {"fade", "pop", "slide-auto", "slide-up", "slide-down", "slide-left", "slide-right"};
+static const effect_func effect_funcs[] = {fade, pop, slide_auto, slide_up, slide_down, slide_left, slide_right, morph};
+static const char *effect_funcs_names[] = {"fade", "pop", "slide-auto", "slide-up", "slide-down", "slide-left", "slide-right",
+                                           "morph"};
 effect_func get_effect_func_from_name(const char *name) {
     unsigned int size = sizeof(effect_funcs_names) / sizeof(effect_funcs_names[0]);
     for (unsigned int i = 0; i < size; i++)
@@ -89,29 +152,30 @@ effect_func get_effect_func_from_name(const char *name) {
     return NULL;
 }
 
-effect *effect_find(const char *name) {
-    for (effect *e = effects; e; e = e->next) {
+effect *effect_find(effect_table *table, const char *name) {
+    for (effect *e = table->effects; e; e = e->next) {
         if (strcmp(e->name, name) == 0)
             return e;
     }
     return NULL;
 }
 
-void effect_new(const char *name, const char *function_name, double step) {
-    if (effect_find(name))
-        return;
-    effect *e = ecalloc(1, sizeof(effect));
+effect *effect_new(effect_table *table, const char *name, const char *function_name, double step) {
+    effect *e = effect_find(table, name);
+    if (e)
+        return e;
 
-    e->func = get_effect_func_from_name(function_name);
-    if (!e->func) {
-        free(e);
-        return;
-    }
-    e->name = name;
+    effect_func func = get_effect_func_from_name(function_name);
+    if (!func)
+        return NULL;
+
+    e = ecalloc(1, sizeof(effect));
+    e->func = func;
+    e->name = strdup(name);
     e->step = step;
 
-    e->next = effects;
-    effects = e;
+    e->next = table->effects;
+    table->effects = e;
 
-    return;
+    return e;
 }
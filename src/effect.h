@@ -19,19 +19,67 @@ typedef void (*effect_func)(win *w, double progress, void **effect_data);
 
 typedef struct _effect {
     struct _effect *next;
-    const char *name;
+    char *name;
     effect_func func;
     double step;
 } effect;
 
+struct _rule_set;
+
+// effects defined by the config, the effect each window type uses for each event and the window rules
+typedef struct _effect_table {
+    effect *effects;
+    effect *dispatch[NUM_WINTYPES][NUM_EVENT_EFFECTS];
+    struct _rule_set *rules;
+} effect_table;
+
 effect_func get_effect_func_from_name(const char *name);
 
 const char *get_event_effect_name(event_effect effect);
 
-effect *effect_find(const char *name);
+effect_table *effect_table_new(void);
+
+void effect_table_free(effect_table *table);
+
+/*
+ * makes table the one effect_get() reads from and frees the previous one,
+ * running actions finish with the function and step of the effect they started with
+ */
+void effect_table_swap(effect_table *table);
+
+effect *effect_find(effect_table *table, const char *name);
+
+/*
+ * returns the effect of table called name, created if it does not exist, NULL if function_name is unknown
+ */
+effect *effect_new(effect_table *table, const char *name, const char *function_name, double step);
+
+void effect_set(effect_table *table, wintype window_type, event_effect event, effect *e);
+
+/*
+ * returns the effect of w for event, the one of its window rule if it sets one, else the one of its type,
+ * NULL while effects are paused
+ */
+effect *effect_get(win *w, event_effect event);
+
+/*
+ * returns the effect animating desktop switches, the desktop-change-effect of the normal window type,
+ * NULL while effects are paused
+ */
+effect *effect_get_desktop_change(void);
 
-void effect_new(const char *name, const char *function_name, double step);
+/*
+ * returns True if e animates moves and resizes from the previous geometry of windows (see src/morph.h)
+ */
+Bool effect_is_morph(effect *e);
 
-void effect_set(wintype window_type, event_effect event, effect *e);
+/*
+ * returns in dx and dy the direction (-1, 0 or 1) whole desktops slide to with func, both are 0 if
+ * they are cross-faded instead, forward is True if the new desktop comes after the previous one
+ */
+void effect_slide_direction(effect_func func, Bool forward, int *dx, int *dy);
 
-effect *effect_get(wintype window_type, event_effect event);
+/*
+ * returns the window rules of the current table, NULL before the config is read
+ */
+struct _rule_set *effect_rules(void);
@@ -0,0 +1,332 @@
+#include "ipc.h"
+#include "action.h"
+#include "capture.h"
+#include "record.h"
+#include "session.h"
+#include "stats.h"
+#include "thumbnail.h"
+#include "window.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define IPC_LINE_MAX 512 // longest command accepted, a client sending a longer one is disconnected
+#define IPC_MAX_ARGS 2
+
+typedef struct _ipc_client {
+    char line[IPC_LINE_MAX]; // received bytes not forming a full line yet
+    int len;
+} ipc_client;
+
+typedef struct _ipc_command {
+    const char *name;
+    const char *usage;
+    int n_args;
+    const char *(*run)(FILE *out, char **args); // writes the reply to out, returns an error or NULL
+} ipc_command;
+
+static ipc_client clients[IPC_MAX_CLIENTS];
+static char socket_path[sizeof(((struct sockaddr_un *) 0)->sun_path)];
+
+static const char *list_windows(FILE *out, char **args) {
+    static const char *modes[] = {"solid", "trans", "argb"};
+
+    for (win *w = s.managed_windows; w; w = w->next) {
+        fprintf(out, "0x%lx %s %s %s %.2f %d %d %d %d", w->id,
+                w->attr.map_state == IsViewable ? "mapped" : "unmapped", get_wintype_name(w->window_type),
+                modes[w->mode], w->opacity, w->attr.x, w->attr.y, w->attr.width, w->attr.height);
+        if (w->action_running)
+            fputs(" animating", out);
+        if (w->unredirect)
+            fputs(" unredirect", out);
+        if (w->unredirect_override >= 0)
+            fputs(" override", out);
+        fputc('\n', out);
+    }
+    return NULL;
+}
+
+static const char *print_stats(FILE *out, char **args) {
+    stats_print(out);
+    fprintf(out, "animations: %d\n", action_count());
+    fprintf(out, "effects: %s\n", s.effects_paused ? "off" : "on");
+    fprintf(out, "unredirected: %s\n", s.unredirected ? "yes" : "no");
+    return NULL;
+}
+
+static const char *set_effects(FILE *out, char **args) {
+    if (strcmp(args[0], "on") == 0)
+        session_pause_effects(False);
+    else if (strcmp(args[0], "off") == 0)
+        session_pause_effects(True);
+    else
+        return "expected on or off";
+    return NULL;
+}
+
+static const char *set_unredirect(FILE *out, char **args) {
+    char *end;
+    Window id = strtoul(args[0], &end, 0);
+    if (*end != '\0')
+        return "invalid window id";
+    win *w = find_win(id, True);
+    if (!w)
+        return "no such window";
+
+    if (strcmp(args[1], "on") == 0)
+        w->unredirect_override = True;
+    else if (strcmp(args[1], "off") == 0)
+        w->unredirect_override = False;
+    else if (strcmp(args[1], "rule") == 0)
+        w->unredirect_override = -1;
+    else
+        return "expected on, off or rule";
+
+    // the event loop unredirects the window, or composites it again, once this command is done
+    if (w->window_type != WINTYPE_UNKNOWN)
+        apply_effect_rules(w);
+    return NULL;
+}
+
+static const char *get_thumbnail(FILE *out, char **args) {
+    char *end;
+    Window id = strtoul(args[0], &end, 0);
+    if (*end != '\0')
+        return "invalid window id";
+    win *w = find_win(id, True);
+    if (!w)
+        return "no such window";
+
+    XRectangle content;
+    Pixmap pixmap = thumbnail_get(w, &content);
+    if (!pixmap)
+        return "window has no contents";
+    // the client must not use the pixmap before the server created and painted it
+    XSync(s.dpy, False);
+    fprintf(out, "0x%lx %d %d %d %d\n", pixmap, content.x, content.y, content.width, content.height);
+    return NULL;
+}
+
+static const char *capture(FILE *out, char **args) {
+    int id = capture_segment();
+    if (id < 0)
+        return s.capture ? "no frame captured yet" : "capture is disabled";
+    fprintf(out, "%d\n", id);
+    return NULL;
+}
+
+static const char *reload(FILE *out, char **args) {
+    return session_reload_config() ? NULL : "config not reloaded, see the compositor output";
+}
+
+static const char *record(FILE *out, char **args) {
+    if (strcmp(args[0], "stop") == 0)
+        record_close();
+    else if (!record_open(args[0]))
+        return "cannot open record file";
+    return NULL;
+}
+
+static const ipc_command commands[] = {
+    {"windows", "windows", 0, list_windows},
+    {"stats", "stats", 0, print_stats},
+    {"effects", "effects on|off", 1, set_effects},
+    {"unredirect", "unredirect <id> on|off|rule", 2, set_unredirect},
+    {"thumbnail", "thumbnail <id>", 1, get_thumbnail},
+    {"capture", "capture", 0, capture},
+    {"reload", "reload", 0, reload},
+    {"record", "record <path>|stop", 1, record},
+};
+
+/*
+ * sends the whole reply or nothing, returns False if the client is gone or does not read its replies
+ */
+static Bool send_reply(int fd, const char *reply, size_t size) {
+    return send(fd, reply, size, MSG_DONTWAIT | MSG_NOSIGNAL) == (ssize_t) size;
+}
+
+/*
+ * runs the command on line and replies to fd, returns False if the reply could not be sent
+ */
+static Bool run_command(int fd, char *line) {
+    char *args[IPC_MAX_ARGS + 1];
+    char *saveptr;
+    int n_args = 0;
+
+    char *name = strtok_r(line, " \t\r", &saveptr);
+    if (!name)
+        return True;
+    while (n_args <= IPC_MAX_ARGS && (args[n_args] = strtok_r(NULL, " \t\r", &saveptr)))
+        n_args++;
+
+    char *reply = NULL;
+    size_t size = 0;
+    FILE *out = open_memstream(&reply, &size);
+    if (!out)
+        return False;
+
+    const char *error = "unknown command";
+    for (size_t i = 0; i < sizeof(commands) / sizeof(commands[0]); i++) {
+        if (strcmp(name, commands[i].name) != 0)
+            continue;
+        if (n_args != commands[i].n_args) {
+            fprintf(out, "error usage: %s\n", commands[i].usage);
+            error = NULL;
+        } else if ((error = commands[i].run(out, args)) == NULL) {
+            fputs("ok\n", out);
+        }
+        break;
+    }
+    if (error)
+        fprintf(out, "error %s\n", error);
+    fclose(out);
+
+    Bool sent = send_reply(fd, reply, size);
+    free(reply);
+    return sent;
+}
+
+static void drop_client(int i) {
+    close(s.ufds[UFD_IPC_CLIENTS + i].fd);
+    s.ufds[UFD_IPC_CLIENTS + i].fd = -1;
+}
+
+static void read_client(int i) {
+    int fd = s.ufds[UFD_IPC_CLIENTS + i].fd;
+    ipc_client *c = &clients[i];
+
+    ssize_t n = read(fd, c->line + c->len, sizeof(c->line) - c->len);
+    if (n < 0 && (errno == EAGAIN || errno == EINTR))
+        return;
+    if (n <= 0) {
+        drop_client(i);
+        return;
+    }
+    c->len += n;
+
+    char *start = c->line, *eol;
+    while ((eol = memchr(start, '\n', c->line + c->len - start))) {
+        *eol = '\0';
+        if (!run_command(fd, start)) {
+            drop_client(i);
+            return;
+        }
+        start = eol + 1;
+    }
+    c->len -= start - c->line;
+    memmove(c->line, start, c->len);
+
+    if (c->len == sizeof(c->line)) {
+        static const char error[] = "error command too long\n";
+        send_reply(fd, error, sizeof(error) - 1);
+        drop_client(i);
+    }
+}
+
+static void accept_client(void) {
+    int fd = accept(s.ufds[UFD_IPC].fd, NULL, NULL);
+    if (fd < 0)
+        return;
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+    for (int i = 0; i < IPC_MAX_CLIENTS; i++) {
+        if (s.ufds[UFD_IPC_CLIENTS + i].fd < 0) {
+            s.ufds[UFD_IPC_CLIENTS + i].fd = fd;
+            clients[i].len = 0;
+            return;
+        }
+    }
+
+    static const char error[] = "error too many clients\n";
+    send_reply(fd, error, sizeof(error) - 1);
+    close(fd);
+}
+
+/*
+ * returns True if a compositor already listens on addr, a socket left by one that did not exit cleanly is not
+ */
+static Bool socket_in_use(struct sockaddr_un *addr) {
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return False;
+    Bool in_use = connect(fd, (struct sockaddr *) addr, sizeof(*addr)) == 0;
+    close(fd);
+    return in_use;
+}
+
+void ipc_init(const char *path) {
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    int len;
+
+    s.ufds[UFD_IPC].fd = -1;
+    s.ufds[UFD_IPC].events = POLLIN;
+    for (int i = 0; i < IPC_MAX_CLIENTS; i++) {
+        s.ufds[UFD_IPC_CLIENTS + i].fd = -1;
+        s.ufds[UFD_IPC_CLIENTS + i].events = POLLIN;
+    }
+
+    if (path) {
+        len = snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+    } else {
+        // only the display number tells local compositors apart, the screen is always the default one
+        const char *colon = strrchr(DisplayString(s.dpy), ':');
+        int display = colon ? atoi(colon + 1) : 0;
+        const char *dir = getenv("XDG_RUNTIME_DIR");
+        if (dir)
+            len = snprintf(addr.sun_path, sizeof(addr.sun_path), "%s/axcomp-%d.sock", dir, display);
+        else
+            len = snprintf(addr.sun_path, sizeof(addr.sun_path), "/tmp/axcomp-%d-%d.sock", getuid(), display);
+    }
+    if (len >= (int) sizeof(addr.sun_path)) {
+        fprintf(stderr, "control socket path too long\n");
+        return;
+    }
+
+    if (socket_in_use(&addr)) {
+        fprintf(stderr, "%s: control socket already in use\n", addr.sun_path);
+        return;
+    }
+    struct stat st;
+    if (stat(addr.sun_path, &st) == 0 && S_ISSOCK(st.st_mode))
+        unlink(addr.sun_path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0 || bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0 ||
+        chmod(addr.sun_path, S_IRUSR | S_IWUSR) < 0 || listen(fd, IPC_MAX_CLIENTS) < 0) {
+        fprintf(stderr, "%s: cannot create control socket\n", addr.sun_path);
+        if (fd >= 0)
+            close(fd);
+        return;
+    }
+    s.ufds[UFD_IPC].fd = fd;
+    strcpy(socket_path, addr.sun_path);
+}
+
+void ipc_dispatch(void) {
+    // clients first, a slot freed here may be taken by a client accepted below
+    for (int i = 0; i < IPC_MAX_CLIENTS; i++) {
+        if (s.ufds[UFD_IPC_CLIENTS + i].fd >= 0 && s.ufds[UFD_IPC_CLIENTS + i].revents & (POLLIN | POLLHUP | POLLERR))
+            read_client(i);
+    }
+    if (s.ufds[UFD_IPC].revents & POLLIN)
+        accept_client();
+}
+
+void ipc_close(void) {
+    for (int i = 0; i < IPC_MAX_CLIENTS; i++) {
+        if (s.ufds[UFD_IPC_CLIENTS + i].fd >= 0)
+            drop_client(i);
+    }
+    if (s.ufds[UFD_IPC].fd < 0)
+        return;
+    close(s.ufds[UFD_IPC].fd);
+    s.ufds[UFD_IPC].fd = -1;
+    unlink(socket_path);
+}
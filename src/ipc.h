@@ -0,0 +1,33 @@
+#pragma once
+
+/*
+ * control socket, a unix stream socket served by the event loop
+ * clients send one command per line and each reply ends with a line that is either "ok" or "error <reason>"
+ *
+ *   windows                     one line per managed window, top to bottom:
+ *                               <id> <mapped|unmapped> <type> <solid|trans|argb> <opacity> <x> <y> <width> <height> [flags]
+ *                               flags are animating, unredirect and override (unredirect forced through this socket)
+ *   stats                       frame statistics, running animations and session state as "key: value" lines
+ *   effects on|off              turns animations, shadows and background blur off or back on
+ *   unredirect <id> on|off|rule forces whether a window is drawn by the server when it covers the screen on top
+ *   thumbnail <id>              pixmap holding a live thumbnail of a window and the part the window covers:
+ *                               <pixmap> <x> <y> <width> <height> (see src/thumbnail.h)
+ *   capture                     id of the shared memory segment frames are exported to (see src/capture.h)
+ *   reload                      reloads the config file
+ *   record <path>|stop          records the X event stream to path (see bench/replay.c), or stops recording
+ *
+ * a client that does not read its replies is disconnected instead of stalling frames
+ */
+
+/*
+ * listens on path, a path derived from the display under $XDG_RUNTIME_DIR if path is NULL,
+ * the control socket is disabled if it cannot be created
+ */
+void ipc_init(const char *path);
+
+/*
+ * accepts clients and runs the commands they sent, after poll() returned
+ */
+void ipc_dispatch(void);
+
+void ipc_close(void);
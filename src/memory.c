@@ -0,0 +1,74 @@
+#include "memory.h"
+#include "retain.h"
+#include "session.h"
+#include "window.h"
+#include <stdatomic.h>
+
+static atomic_long usage[NUM_MEMORY_KINDS];
+static atomic_bool trim_requested = False;
+static unsigned long int enforced_total = 0; // total left over budget by the last memory_enforce()
+
+static const char *kind_names[] = {"windows", "retained", "thumbnails", "buffers", "blur", "masks"};
+
+unsigned long int memory_pixmap_bytes(int width, int height, int depth) {
+    int bpp = depth <= 1 ? 1 : depth <= 8 ? 8 : depth <= 16 ? 16 : 32;
+    return (unsigned long int) ((width * bpp + 31) / 32) * 4 * height;
+}
+
+void memory_add(memory_kind kind, long int bytes) {
+    atomic_fetch_add_explicit(&usage[kind], bytes, memory_order_relaxed);
+}
+
+unsigned long int memory_usage(memory_kind kind) {
+    return atomic_load_explicit(&usage[kind], memory_order_relaxed);
+}
+
+unsigned long int memory_total(void) {
+    unsigned long int total = 0;
+    for (int i = 0; i < NUM_MEMORY_KINDS; i++)
+        total += memory_usage(i);
+    return total;
+}
+
+void memory_enforce(void) {
+    if (!s.memory_budget)
+        return;
+    unsigned long int total = memory_total();
+    // nothing more can be freed until memory use grows again
+    if (total <= s.memory_budget || total <= enforced_total) {
+        if (total <= s.memory_budget)
+            enforced_total = 0;
+        return;
+    }
+
+    total -= retain_evict(total - s.memory_budget);
+    if (total <= s.memory_budget)
+        return;
+
+    // the render thread owns the blur caches, they are trimmed after its next frame
+    if (memory_usage(MEMORY_BLUR))
+        atomic_store(&trim_requested, True);
+
+    // top to bottom, a window can only be hidden by the ones above it
+    for (win *w = s.managed_windows; w && total > s.memory_budget; w = w->next) {
+        if (!w->pixmap || w->attr.map_state != IsViewable || w->action_running || w->morph_picture ||
+            !win_occluded(w))
+            continue;
+        total -= w->pixmap_bytes;
+        evict_win_pixmap(w);
+    }
+    enforced_total = total;
+}
+
+Bool memory_trim_requested(void) {
+    return atomic_exchange(&trim_requested, False);
+}
+
+void memory_print(FILE *f) {
+    for (int i = 0; i < NUM_MEMORY_KINDS; i++)
+        fprintf(f, "memory %s: %.1f MiB\n", kind_names[i], memory_usage(i) / (1024.0 * 1024.0));
+    fprintf(f, "memory total: %.1f MiB", memory_total() / (1024.0 * 1024.0));
+    if (s.memory_budget)
+        fprintf(f, " (budget %.1f MiB)", s.memory_budget / (1024.0 * 1024.0));
+    fputc('\n', f);
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <X11/Xlib.h>
+#include <stdio.h>
+
+/*
+ * estimate of the X server memory held by the pixmaps axcomp creates or names, by kind of resource
+ * counters are updated from both threads, budget enforcement runs on the event thread
+ */
+
+typedef enum _memory_kind {
+    MEMORY_WINDOWS,    // named pixmaps of mapped windows
+    MEMORY_RETAINED,   // contents of unmapped windows kept for their next map
+    MEMORY_THUMBNAILS, // window thumbnails served to task switchers
+    MEMORY_BUFFERS,    // frame buffers painted by the renderer
+    MEMORY_BLUR,       // blurred backgrounds and the levels they are made with
+    MEMORY_MASKS,      // shadow and rounded corner masks
+    NUM_MEMORY_KINDS
+} memory_kind;
+
+/*
+ * returns the bytes the server uses for a pixmap, rows are padded to 32 bits
+ */
+unsigned long int memory_pixmap_bytes(int width, int height, int depth);
+
+/*
+ * accounts bytes more (or less if negative) for kind
+ */
+void memory_add(memory_kind kind, long int bytes);
+
+unsigned long int memory_usage(memory_kind kind);
+
+unsigned long int memory_total(void);
+
+/*
+ * frees memory until the total fits s.memory_budget: retained contents first, then the blur caches
+ * (the render thread trims them at its next frame) and then the pixmaps of windows hidden by an opaque window
+ */
+void memory_enforce(void);
+
+/*
+ * returns True once after memory_enforce() asked the render thread to trim its caches
+ */
+Bool memory_trim_requested(void);
+
+void memory_print(FILE *f);
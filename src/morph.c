@@ -0,0 +1,149 @@
+#include "morph.h"
+#include "action.h"
+#include "pool.h"
+#include "render.h"
+#include "scene.h"
+#include "session.h"
+#include "util.h"
+#include <X11/Xlib.h>
+#include <X11/extensions/Xrender.h>
+
+typedef struct _morph {
+    struct _morph *next;
+    win *w;
+    XRectangle from; // geometry the animation started from
+    double progress; // from 0 to 1
+    double step;
+} morph;
+
+static morph *morphs = NULL;
+static double effect_time = 0; // time of the next tick
+static double last_tick = 0;
+
+static morph *morph_find(win *w) {
+    for (morph *m = morphs; m; m = m->next) {
+        if (m->w == w)
+            return m;
+    }
+    return NULL;
+}
+
+/*
+ * damages what w covered, moves it to geometry and damages what it covers there
+ */
+static void morph_move(win *w, XRectangle *geometry) {
+    if (w->extents) {
+        add_damage(w->extents); // destroys region
+        w->extents = None;
+    }
+    if (w->border_size) {
+        scene_release_region(w->border_size);
+        w->border_size = None;
+    }
+    w->morph_geometry = *geometry;
+    w->extents = win_extents(w);
+    XserverRegion damage = region_scratch(&event_regions);
+    XFixesCopyRegion(s.dpy, damage, w->extents);
+    add_damage(damage);
+    invalidate_blur(w, geometry);
+}
+
+static void morph_free(morph *m) {
+    for (morph **prev = &morphs; *prev; prev = &(*prev)->next) {
+        if (*prev == m) {
+            *prev = m->next;
+            break;
+        }
+    }
+
+    win *w = m->w;
+    scene_release_picture(w->morph_picture);
+    w->morph_picture = None;
+    free(m);
+
+    // painted from its own pixmap where it is
+    morph_move(w, &w->morph_geometry);
+}
+
+void morph_start(win *w, effect *e) {
+    morph *m = morph_find(w);
+    if (!m) {
+        // nothing was painted yet
+        if (!w->pixmap || !w->damaged || w->stale)
+            return;
+
+        // a picture of its own keeps the pixmap alive once the window frees it after a resize
+        XRenderPictFormat *format = XRenderFindVisualFormat(s.dpy, w->attr.visual);
+        Picture picture = XRenderCreatePicture(s.dpy, w->pixmap, format, 0, NULL);
+        if (!picture)
+            return;
+
+        m = ecalloc(1, sizeof(morph));
+        m->w = w;
+        w->morph_picture = picture;
+        w->morph_width = w->attr.width + w->attr.border_width * 2;
+        w->morph_height = w->attr.height + w->attr.border_width * 2;
+        w->morph_geometry.x = w->attr.x;
+        w->morph_geometry.y = w->attr.y;
+        w->morph_geometry.width = w->morph_width;
+        w->morph_geometry.height = w->morph_height;
+
+        if (!morphs) {
+            last_tick = get_time_in_milliseconds();
+            effect_time = last_tick + s.effect_tick;
+        }
+        m->next = morphs;
+        morphs = m;
+    }
+
+    // a window moved again during its animation goes on from where it is painted
+    m->from = w->morph_geometry;
+    m->progress = 0.0;
+    m->step = e->step;
+}
+
+void morph_cleanup(win *w) {
+    morph *m = morph_find(w);
+    if (m)
+        morph_free(m);
+}
+
+int morph_timeout(void) {
+    if (!morphs)
+        return -1;
+    double delta = effect_time - get_time_in_milliseconds();
+    if (delta <= 0)
+        return 0;
+    return (int) delta + 1;
+}
+
+void morph_run(void) {
+    double now = get_time_in_milliseconds();
+    morph *next = morphs;
+
+    if (!morphs || effect_time - now > 0)
+        return;
+    double steps = action_steps(now, &last_tick);
+    effect_time = now + s.effect_tick;
+
+    while (next) {
+        morph *m = next;
+        win *w = m->w;
+        next = m->next;
+
+        m->progress += m->step * steps;
+        if (m->progress >= 1.0) {
+            morph_free(m);
+            continue;
+        }
+
+        XRectangle to = {w->attr.x, w->attr.y, w->attr.width + w->attr.border_width * 2,
+                         w->attr.height + w->attr.border_width * 2};
+        XRectangle r;
+        r.x = m->from.x + (to.x - m->from.x) * m->progress;
+        r.y = m->from.y + (to.y - m->from.y) * m->progress;
+        r.width = m->from.width + (to.width - m->from.width) * m->progress;
+        r.height = m->from.height + (to.height - m->from.height) * m->progress;
+        morph_move(w, &r);
+    }
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "effect.h"
+#include "window.h"
+
+/*
+ * animation of the moves and resizes of windows whose move-effect or maximize-effect uses the morph function
+ * the contents a window had before its geometry changed are kept in a picture of its previous pixmap
+ * and stretched from the geometry they are painted at to the new one with a single transform, the client
+ * is not asked to paint the intermediate sizes and only the rectangles painted by consecutive steps are damaged
+ * the window is painted from its new pixmap again once the animation ends
+ */
+
+/*
+ * starts animating w from the geometry it is painted at, before configure_win() applies the new one
+ */
+void morph_start(win *w, effect *e);
+
+/*
+ * stops animating w, it is painted at its geometry again
+ */
+void morph_cleanup(win *w);
+
+/*
+ * returns the poll timeout until the next step of the animations, -1 if there is none
+ */
+int morph_timeout(void);
+
+/*
+ * steps the animations that are due
+ */
+void morph_run(void);
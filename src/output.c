@@ -0,0 +1,177 @@
+#include "output.h"
+#include "pool.h"
+#include "session.h"
+#include "util.h"
+#include <X11/Xlib.h>
+#include <X11/extensions/Xfixes.h>
+#include <X11/extensions/Xrandr.h>
+
+#define OUTPUT_DEFAULT_REFRESH 60 // used for the effect tick when no refresh rate is known
+
+static Bool frame_scheduled = False; // output_take_damage() returned damage no scene was painted with yet
+
+static double mode_refresh(XRRScreenResources *res, RRMode id) {
+    for (int i = 0; i < res->nmode; i++) {
+        XRRModeInfo *mode = &res->modes[i];
+        if (mode->id != id)
+            continue;
+
+        double vtotal = mode->vTotal;
+        if (mode->modeFlags & RR_DoubleScan)
+            vtotal *= 2;
+        if (mode->modeFlags & RR_Interlace)
+            vtotal /= 2;
+        if (!mode->hTotal || !vtotal)
+            return 0;
+        return mode->dotClock / (mode->hTotal * vtotal);
+    }
+    return 0;
+}
+
+static output *output_new(int x, int y, int width, int height, double refresh) {
+    s.outputs = erealloc(s.outputs, (s.n_outputs + 1) * sizeof(output));
+    output *o = &s.outputs[s.n_outputs++];
+    o->geometry.x = x;
+    o->geometry.y = y;
+    o->geometry.width = width;
+    o->geometry.height = height;
+    o->refresh = refresh;
+    o->area = region_get(&event_regions, &o->geometry, 1);
+    o->damage = None;
+    o->next_frame = 0;
+    return o;
+}
+
+void output_update_tick(void) {
+    double refresh = 0;
+    for (int i = 0; i < s.n_outputs; i++)
+        if (s.outputs[i].refresh > refresh)
+            refresh = s.outputs[i].refresh;
+
+    // animations step once per refresh of the fastest output
+    if (s.effect_delta > 0)
+        s.effect_tick = s.effect_delta;
+    else
+        s.effect_tick = 1e3 / (refresh > 0 ? refresh : OUTPUT_DEFAULT_REFRESH);
+}
+
+void output_update(void) {
+    for (int i = 0; i < s.n_outputs; i++) {
+        region_put(&event_regions, s.outputs[i].area);
+        if (s.outputs[i].damage)
+            region_put(&event_regions, s.outputs[i].damage);
+    }
+    s.n_outputs = 0;
+
+    XRRScreenResources *res = s.has_randr ? XRRGetScreenResourcesCurrent(s.dpy, s.root) : NULL;
+    if (res) {
+        for (int i = 0; i < res->ncrtc; i++) {
+            XRRCrtcInfo *crtc = XRRGetCrtcInfo(s.dpy, res, res->crtcs[i]);
+            if (!crtc)
+                continue;
+            if (crtc->mode && crtc->noutput > 0)
+                output_new(crtc->x, crtc->y, crtc->width, crtc->height, mode_refresh(res, crtc->mode));
+            XRRFreeCrtcInfo(crtc);
+        }
+        XRRFreeScreenResources(res);
+    }
+
+    if (!s.n_outputs)
+        output_new(0, 0, s.root_width, s.root_height, 0);
+    output_update_tick();
+}
+
+void output_init(void) {
+    s.outputs = NULL;
+    s.n_outputs = 0;
+    s.has_randr = XRRQueryExtension(s.dpy, &s.randr_event, &s.randr_error);
+    if (s.has_randr)
+        XRRSelectInput(s.dpy, s.root, RRScreenChangeNotifyMask);
+    output_update();
+}
+
+static void output_damage(output *o, XserverRegion damage) {
+    if (!o->damage) {
+        o->damage = region_scratch(&event_regions);
+        XFixesIntersectRegion(s.dpy, o->damage, damage, o->area);
+    } else {
+        XserverRegion part = region_scratch(&event_regions);
+        XFixesIntersectRegion(s.dpy, part, damage, o->area);
+        XFixesUnionRegion(s.dpy, o->damage, o->damage, part);
+        region_put(&event_regions, part);
+    }
+}
+
+void output_add_damage(XserverRegion damage) {
+    // a single output takes everything, there is no need to know where the damage is
+    if (s.n_outputs == 1) {
+        if (s.outputs[0].damage) {
+            XFixesUnionRegion(s.dpy, s.outputs[0].damage, s.outputs[0].damage, damage);
+            region_put(&event_regions, damage);
+        } else
+            s.outputs[0].damage = damage;
+        return;
+    }
+
+    int n;
+    XRectangle *rects = XFixesFetchRegion(s.dpy, damage, &n);
+    for (int i = 0; i < s.n_outputs; i++) {
+        output *o = &s.outputs[i];
+        for (int j = 0; j < n; j++) {
+            if (rects[j].x < o->geometry.x + o->geometry.width && o->geometry.x < rects[j].x + rects[j].width &&
+                rects[j].y < o->geometry.y + o->geometry.height && o->geometry.y < rects[j].y + rects[j].height) {
+                output_damage(o, damage);
+                break;
+            }
+        }
+    }
+    if (rects)
+        XFree(rects);
+    region_put(&event_regions, damage);
+}
+
+int output_timeout(void) {
+    double now = get_time_in_milliseconds();
+    int timeout = -1;
+
+    for (int i = 0; i < s.n_outputs; i++) {
+        if (!s.outputs[i].damage)
+            continue;
+        double delta = s.outputs[i].next_frame - now;
+        int t = delta > 0 ? (int) delta + 1 : 0;
+        if (timeout < 0 || t < timeout)
+            timeout = t;
+    }
+    return timeout;
+}
+
+XserverRegion output_take_damage(void) {
+    double now = get_time_in_milliseconds();
+    XserverRegion region = None;
+
+    for (int i = 0; i < s.n_outputs; i++) {
+        output *o = &s.outputs[i];
+        if (!o->damage || o->next_frame > now)
+            continue;
+
+        if (region) {
+            XFixesUnionRegion(s.dpy, region, region, o->damage);
+            region_put(&event_regions, o->damage);
+        } else
+            region = o->damage;
+        o->damage = None;
+
+        // a late frame does not make the next one early
+        double period = o->refresh > 0 ? 1e3 / o->refresh : 0;
+        o->next_frame = o->next_frame + period > now ? o->next_frame + period : now + period;
+    }
+    if (region)
+        frame_scheduled = True;
+    return region;
+}
+
+Bool output_frame_scheduled(void) {
+    Bool scheduled = frame_scheduled;
+    frame_scheduled = False;
+    return scheduled;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <X11/Xlib.h>
+#include <X11/extensions/Xfixes.h>
+
+/*
+ * monitors (RandR CRTCs) of the screen, each one has its own damage and paints at its own refresh rate
+ * without RandR the whole root is a single output painted as soon as it is damaged
+ */
+
+typedef struct _output {
+    XRectangle geometry;
+    double refresh;       // in Hz, 0 if unknown
+    XserverRegion area;   // geometry as a region
+    XserverRegion damage; // damage not painted yet, None if there is none
+    double next_frame;    // earliest time of the next frame, in milliseconds
+} output;
+
+/*
+ * queries RandR, selects screen change events and discovers the outputs
+ */
+void output_init(void);
+
+/*
+ * discovers the outputs again after a screen change, pending damage is dropped
+ */
+void output_update(void);
+
+/*
+ * sets s.effect_tick from s.effect_delta or, if it is 0, from the fastest output refresh rate
+ */
+void output_update_tick(void);
+
+/*
+ * splits damage between the outputs it overlaps, damage is given back to the event thread region pool
+ */
+void output_add_damage(XserverRegion damage);
+
+/*
+ * returns the milliseconds until an output with pending damage can paint, -1 if there is none
+ */
+int output_timeout(void);
+
+/*
+ * returns the damage of the outputs due for a frame and schedules their next one, None if there is none
+ */
+XserverRegion output_take_damage(void);
+
+/*
+ * returns True once after output_take_damage() returned damage, a scene painted otherwise is out of band
+ */
+Bool output_frame_scheduled(void);
@@ -0,0 +1,83 @@
+#include "pool.h"
+#include "session.h"
+#include "util.h"
+#include <X11/Xlib.h>
+#include <X11/extensions/Xfixes.h>
+#include <X11/extensions/Xrender.h>
+#include <stdatomic.h>
+#include <string.h>
+
+struct pool_counters pool_counters;
+
+region_pool event_regions = {.dpy = &s.dpy};
+region_pool render_regions = {.dpy = &s.render_dpy};
+
+XserverRegion region_get(region_pool *pool, XRectangle *rects, int n) {
+    if (!pool->n_regions) {
+        atomic_fetch_add_explicit(&pool_counters.region_misses, 1, memory_order_relaxed);
+        return XFixesCreateRegion(*pool->dpy, rects, n);
+    }
+
+    atomic_fetch_add_explicit(&pool_counters.region_hits, 1, memory_order_relaxed);
+    XserverRegion region = pool->regions[--pool->n_regions];
+    XFixesSetRegion(*pool->dpy, region, rects, n);
+    return region;
+}
+
+XserverRegion region_scratch(region_pool *pool) {
+    if (!pool->n_regions) {
+        atomic_fetch_add_explicit(&pool_counters.region_misses, 1, memory_order_relaxed);
+        return XFixesCreateRegion(*pool->dpy, NULL, 0);
+    }
+
+    atomic_fetch_add_explicit(&pool_counters.region_hits, 1, memory_order_relaxed);
+    return pool->regions[--pool->n_regions];
+}
+
+// the pool never shrinks, it holds as many regions as were in use at the busiest time
+void region_put(region_pool *pool, XserverRegion region) {
+    if (pool->n_regions == pool->size_regions)
+        pool->regions = erealloc(pool->regions, (pool->size_regions += 64) * sizeof(XserverRegion));
+    pool->regions[pool->n_regions++] = region;
+}
+
+Picture picture_get(picture_pool *pool, int width, int height) {
+    // most recently released first, it is the most likely to be reused at the same size again
+    for (int i = pool->n_pictures - 1; i >= 0; i--) {
+        if (pool->pictures[i].width != width || pool->pictures[i].height != height)
+            continue;
+
+        atomic_fetch_add_explicit(&pool_counters.picture_hits, 1, memory_order_relaxed);
+        Picture picture = pool->pictures[i].picture;
+        memmove(&pool->pictures[i], &pool->pictures[i + 1], (pool->n_pictures - i - 1) * sizeof(pooled_picture));
+        pool->n_pictures--;
+        return picture;
+    }
+
+    atomic_fetch_add_explicit(&pool_counters.picture_misses, 1, memory_order_relaxed);
+    return None;
+}
+
+void picture_put(picture_pool *pool, Picture picture, int width, int height) {
+    if (!pool->pictures)
+        pool->pictures = ecalloc(pool->max_pictures, sizeof(pooled_picture));
+
+    if (pool->n_pictures == pool->max_pictures) {
+        XRenderFreePicture(*pool->dpy, pool->pictures[0].picture);
+        memory_add(pool->memory, -(long int) memory_pixmap_bytes(pool->pictures[0].width, pool->pictures[0].height, pool->depth));
+        memmove(&pool->pictures[0], &pool->pictures[1], (pool->n_pictures - 1) * sizeof(pooled_picture));
+        pool->n_pictures--;
+    }
+    pool->pictures[pool->n_pictures].picture = picture;
+    pool->pictures[pool->n_pictures].width = width;
+    pool->pictures[pool->n_pictures].height = height;
+    pool->n_pictures++;
+}
+
+void picture_pool_clear(picture_pool *pool) {
+    for (int i = 0; i < pool->n_pictures; i++) {
+        XRenderFreePicture(*pool->dpy, pool->pictures[i].picture);
+        memory_add(pool->memory, -(long int) memory_pixmap_bytes(pool->pictures[i].width, pool->pictures[i].height, pool->depth));
+    }
+    pool->n_pictures = 0;
+}
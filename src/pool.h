@@ -0,0 +1,75 @@
+#pragma once
+
+#include "memory.h"
+#include <X11/Xlib.h>
+#include <X11/extensions/Xfixes.h>
+#include <X11/extensions/Xrender.h>
+#include <stdatomic.h>
+
+/*
+ * server resources kept for reuse instead of being destroyed and created again
+ * a pool belongs to the thread using its display connection
+ */
+
+typedef struct _region_pool {
+    Display **dpy;
+    XserverRegion *regions;
+    int n_regions, size_regions;
+} region_pool;
+
+typedef struct _pooled_picture {
+    Picture picture;
+    int width, height;
+} pooled_picture;
+
+// pictures of a single format and set of attributes, matched by size
+typedef struct _picture_pool {
+    Display **dpy;
+    memory_kind memory; // where the pixmaps of its pictures are accounted
+    int depth;          // depth of the pixmaps of its pictures
+    pooled_picture *pictures; // oldest first
+    int n_pictures, max_pictures;
+} picture_pool;
+
+struct pool_counters {
+    atomic_ulong region_hits;
+    atomic_ulong region_misses;
+    atomic_ulong picture_hits;
+    atomic_ulong picture_misses;
+};
+
+extern struct pool_counters pool_counters;
+
+extern region_pool event_regions;  // s.dpy
+extern region_pool render_regions; // s.render_dpy
+
+/*
+ * returns a region holding rects
+ */
+XserverRegion region_get(region_pool *pool, XRectangle *rects, int n);
+
+/*
+ * returns a region with undefined contents, for the destination of a region operation
+ */
+XserverRegion region_scratch(region_pool *pool);
+
+/*
+ * gives region back to pool, it must not be used anymore
+ */
+void region_put(region_pool *pool, XserverRegion region);
+
+/*
+ * returns a picture of the given size or None if the caller must create one
+ * its contents, transform and clip are left as its previous user set them
+ */
+Picture picture_get(picture_pool *pool, int width, int height);
+
+/*
+ * gives picture back to pool, the oldest picture is freed if the pool is full
+ */
+void picture_put(picture_pool *pool, Picture picture, int width, int height);
+
+/*
+ * frees every picture of pool
+ */
+void picture_pool_clear(picture_pool *pool);
@@ -0,0 +1,163 @@
+#include "present.h"
+#include "memory.h"
+#include "session.h"
+#include "util.h"
+#include <X11/Xlib.h>
+#include <X11/extensions/Xcomposite.h>
+#include <X11/extensions/Xfixes.h>
+#include <X11/extensions/Xpresent.h>
+#include <X11/extensions/Xrender.h>
+#include <X11/extensions/shape.h>
+#include <stdint.h>
+
+#define PRESENT_BUFFERS 3
+#define PRESENT_MAX_AGE 4 // frames of damage remembered, older buffers are repainted entirely
+
+typedef struct _present_buffer {
+    Pixmap pixmap;
+    Picture picture;
+    Bool idle;                    // not used by the server anymore
+    unsigned long int last_frame; // 0 if its content is undefined
+} present_buffer_t;
+
+static present_buffer_t buffers[PRESENT_BUFFERS];
+static int current = -1;
+static int buffer_width = 0, buffer_height = 0;
+
+static Window overlay = None;
+static int present_opcode;
+static unsigned long int frame = 0;
+
+// damage of the last frames, history[frame % PRESENT_MAX_AGE] is the damage of frame
+static XserverRegion history[PRESENT_MAX_AGE];
+
+Bool present_init(void) {
+    int event, error;
+    if (!XPresentQueryExtension(s.render_dpy, &present_opcode, &event, &error))
+        return False;
+
+    overlay = XCompositeGetOverlayWindow(s.render_dpy, s.root);
+    if (!overlay)
+        return False;
+
+    // input goes through the overlay to the windows below
+    XserverRegion empty = XFixesCreateRegion(s.render_dpy, NULL, 0);
+    XFixesSetWindowShapeRegion(s.render_dpy, overlay, ShapeInput, 0, 0, empty);
+    XFixesDestroyRegion(s.render_dpy, empty);
+
+    XPresentSelectInput(s.render_dpy, overlay, PresentIdleNotifyMask);
+    for (int i = 0; i < PRESENT_MAX_AGE; i++)
+        history[i] = XFixesCreateRegion(s.render_dpy, NULL, 0);
+    return True;
+}
+
+static void present_free_buffers(void) {
+    for (int i = 0; i < PRESENT_BUFFERS; i++) {
+        if (buffers[i].picture)
+            XRenderFreePicture(s.render_dpy, buffers[i].picture);
+        if (buffers[i].pixmap) {
+            XFreePixmap(s.render_dpy, buffers[i].pixmap);
+            memory_add(MEMORY_BUFFERS, -(long int) memory_pixmap_bytes(buffer_width, buffer_height,
+                                                                       DefaultDepth(s.render_dpy, s.screen)));
+        }
+        buffers[i].picture = None;
+        buffers[i].pixmap = None;
+    }
+}
+
+static void present_alloc_buffers(int width, int height) {
+    present_free_buffers();
+    for (int i = 0; i < PRESENT_BUFFERS; i++) {
+        buffers[i].pixmap = XCreatePixmap(s.render_dpy, s.root, width, height, DefaultDepth(s.render_dpy, s.screen));
+        memory_add(MEMORY_BUFFERS, memory_pixmap_bytes(width, height, DefaultDepth(s.render_dpy, s.screen)));
+        buffers[i].picture = XRenderCreatePicture(s.render_dpy, buffers[i].pixmap,
+                                                  XRenderFindVisualFormat(s.render_dpy,
+                                                                          DefaultVisual(s.render_dpy, s.screen)),
+                                                  0, NULL);
+        buffers[i].idle = True;
+        buffers[i].last_frame = 0;
+    }
+    buffer_width = width;
+    buffer_height = height;
+}
+
+void present_show_overlay(Bool show) {
+    if (!overlay)
+        return;
+    if (show)
+        XMapWindow(s.dpy, overlay);
+    else
+        XUnmapWindow(s.dpy, overlay);
+}
+
+static Bool is_present_event(Display *dpy, XEvent *ev, XPointer arg) {
+    return ev->type == GenericEvent && ev->xcookie.extension == present_opcode;
+}
+
+Bool present_handle_event(XEvent *ev) {
+    if (!overlay || !is_present_event(s.render_dpy, ev, NULL))
+        return False;
+
+    XGenericEventCookie *cookie = &ev->xcookie;
+    if (XGetEventData(s.render_dpy, cookie)) {
+        if (cookie->evtype == PresentIdleNotify) {
+            XPresentIdleNotifyEvent *idle = cookie->data;
+            for (int i = 0; i < PRESENT_BUFFERS; i++)
+                if (buffers[i].pixmap == idle->pixmap)
+                    buffers[i].idle = True;
+        }
+        XFreeEventData(s.render_dpy, cookie);
+    }
+    return True;
+}
+
+Picture present_buffer(XserverRegion region, int width, int height) {
+    XEvent ev;
+    while (XCheckIfEvent(s.render_dpy, &ev, is_present_event, NULL))
+        present_handle_event(&ev);
+
+    if (width != buffer_width || height != buffer_height)
+        present_alloc_buffers(width, height);
+
+    // the idle buffer painted last has the least damage to catch up with
+    for (;;) {
+        current = -1;
+        for (int i = 0; i < PRESENT_BUFFERS; i++)
+            if (buffers[i].idle && (current < 0 || buffers[i].last_frame > buffers[current].last_frame))
+                current = i;
+        if (current >= 0)
+            break;
+
+        // only Present events are taken, other events stay queued for the event loop
+        XIfEvent(s.render_dpy, &ev, is_present_event, NULL);
+        present_handle_event(&ev);
+    }
+
+    frame++;
+    XFixesCopyRegion(s.render_dpy, history[frame % PRESENT_MAX_AGE], region);
+
+    present_buffer_t *b = &buffers[current];
+    unsigned long int age = b->last_frame ? frame - b->last_frame : 0;
+    if (!age || age >= PRESENT_MAX_AGE) {
+        XRectangle r = {0, 0, width, height};
+        XFixesSetRegion(s.render_dpy, region, &r, 1);
+    } else {
+        for (unsigned long int f = b->last_frame + 1; f < frame; f++)
+            XFixesUnionRegion(s.render_dpy, region, region, history[f % PRESENT_MAX_AGE]);
+    }
+    return b->picture;
+}
+
+Pixmap present_pixmap(void) {
+    return buffers[current].pixmap;
+}
+
+void present_frame(void) {
+    present_buffer_t *b = &buffers[current];
+
+    // only the damage of this frame differs from what is on screen
+    XPresentPixmap(s.render_dpy, overlay, b->pixmap, frame, None, history[frame % PRESENT_MAX_AGE],
+                   0, 0, None, None, None, 0, 0, 0, 0, NULL, 0);
+    b->idle = False;
+    b->last_frame = frame;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <X11/Xlib.h>
+#include <X11/extensions/Xfixes.h>
+#include <X11/extensions/Xrender.h>
+
+/*
+ * presentation of frames through the Present extension on the composite overlay window
+ * frames are painted into one of a few back buffers, each one only repaints the damage it missed
+ * render thread only (or the event thread without render thread)
+ */
+
+/*
+ * gets the overlay window and sets up the back buffers, returns False if Present cannot be used
+ */
+Bool present_init(void);
+
+/*
+ * returns the picture of an idle back buffer to paint the next frame into, waiting for one if needed
+ * region is the damage of the frame, it is extended with the damage the buffer missed since it was last painted
+ */
+Picture present_buffer(XserverRegion region, int width, int height);
+
+/*
+ * returns the pixmap of the back buffer returned by the last present_buffer() call
+ */
+Pixmap present_pixmap(void);
+
+/*
+ * presents the back buffer returned by the last present_buffer() call
+ */
+void present_frame(void);
+
+/*
+ * maps or unmaps the overlay window while compositing is suspended, event thread only
+ */
+void present_show_overlay(Bool show);
+
+/*
+ * handles a Present event of s.render_dpy, returns False if ev is not one
+ */
+Bool present_handle_event(XEvent *ev);
@@ -0,0 +1,172 @@
+#include "record.h"
+#include "session.h"
+#include "util.h"
+#include "window.h"
+#include <X11/Xlib.h>
+#include <X11/extensions/Xdamage.h>
+#include <X11/extensions/shape.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+
+static FILE *record_file = NULL;
+static struct timeval last_record;
+
+static void record_write(record_kind kind, const void *payload, size_t size) {
+    struct timeval now;
+    gettimeofday(&now, NULL);
+
+    uint64_t delay = (now.tv_sec - last_record.tv_sec) * 1000000ULL + now.tv_usec - last_record.tv_usec;
+    record_entry e = {
+        .kind = kind,
+        .delay = delay > UINT32_MAX ? UINT32_MAX : delay};
+    last_record = now;
+
+    fwrite(&e, sizeof(e), 1, record_file);
+    fwrite(payload, size, 1, record_file);
+}
+
+static void record_set_geometry(record_geometry *g, int x, int y, int width, int height, int border_width) {
+    g->x = x;
+    g->y = y;
+    g->width = width;
+    g->height = height;
+    g->border_width = border_width;
+}
+
+static void record_create_win(win *w) {
+    record_create r = {
+        .window = w->id,
+        .override_redirect = w->attr.override_redirect,
+        .depth = w->attr.class == InputOnly ? 0 : w->attr.depth};
+    record_set_geometry(&r.geometry, w->attr.x, w->attr.y, w->attr.width, w->attr.height, w->attr.border_width);
+    record_write(RECORD_CREATE, &r, sizeof(r));
+}
+
+static void record_map_win(win *w) {
+    record_map r = {.window = w->id, .window_type = w->window_type};
+    record_write(RECORD_MAP, &r, sizeof(r));
+
+    // the opacity is read again because a map effect may already have changed w->opacity
+    record_value v = {.window = w->id, .value = get_opacity_prop(w, 1.0) * OPAQUE};
+    record_write(RECORD_OPACITY, &v, sizeof(v));
+}
+
+Bool record_open(const char *path) {
+    record_close();
+    record_file = fopen(path, "wb");
+    if (!record_file) {
+        fprintf(stderr, "cannot open record file '%s'\n", path);
+        return False;
+    }
+
+    record_header h = {
+        .magic = RECORD_MAGIC,
+        .version = RECORD_VERSION,
+        .root_width = s.root_width,
+        .root_height = s.root_height};
+    fwrite(&h, sizeof(h), 1, record_file);
+    gettimeofday(&last_record, NULL);
+
+    // managed windows are stored top to bottom, write them bottom to top to keep the stacking order on replay
+    int n = 0;
+    for (win *w = s.managed_windows; w; w = w->next)
+        n++;
+    win **stack = ecalloc(n, sizeof(win *));
+    n = 0;
+    for (win *w = s.managed_windows; w; w = w->next)
+        stack[n++] = w;
+
+    for (int i = n - 1; i >= 0; i--) {
+        record_create_win(stack[i]);
+        if (stack[i]->attr.map_state == IsViewable)
+            record_map_win(stack[i]);
+    }
+    free(stack);
+    return True;
+}
+
+void record_event(XEvent *ev) {
+    if (!record_file)
+        return;
+
+    win *w;
+    switch (ev->type) {
+    case CreateNotify:
+        if ((w = find_win(ev->xcreatewindow.window, False)))
+            record_create_win(w);
+        break;
+    case ConfigureNotify: {
+        if (!find_win(ev->xconfigure.window, False))
+            break;
+        record_configure r = {
+            .window = ev->xconfigure.window,
+            .above = ev->xconfigure.above,
+            .override_redirect = ev->xconfigure.override_redirect};
+        record_set_geometry(&r.geometry, ev->xconfigure.x, ev->xconfigure.y,
+                            ev->xconfigure.width, ev->xconfigure.height, ev->xconfigure.border_width);
+        record_write(RECORD_CONFIGURE, &r, sizeof(r));
+        break;
+    }
+    case DestroyNotify: {
+        record_window r = {.window = ev->xdestroywindow.window};
+        record_write(RECORD_DESTROY, &r, sizeof(r));
+        break;
+    }
+    case MapNotify:
+        if ((w = find_win(ev->xmap.window, False)))
+            record_map_win(w);
+        break;
+    case UnmapNotify: {
+        record_window r = {.window = ev->xunmap.window};
+        record_write(RECORD_UNMAP, &r, sizeof(r));
+        break;
+    }
+    case ReparentNotify: {
+        record_reparent r = {.window = ev->xreparent.window, .to_root = ev->xreparent.parent == s.root};
+        record_write(RECORD_REPARENT, &r, sizeof(r));
+        // a window reparented to root is added back with fresh attributes
+        if (r.to_root && (w = find_win(ev->xreparent.window, False)))
+            record_create_win(w);
+        break;
+    }
+    case CirculateNotify: {
+        record_circulate r = {.window = ev->xcirculate.window, .place = ev->xcirculate.place};
+        record_write(RECORD_CIRCULATE, &r, sizeof(r));
+        break;
+    }
+    case PropertyNotify:
+        if (!(w = find_win(ev->xproperty.window, True)))
+            break;
+        if (ev->xproperty.atom == s.opacity_atom) {
+            record_value r = {.window = w->id, .value = get_opacity_prop(w, 1.0) * OPAQUE};
+            record_write(RECORD_OPACITY, &r, sizeof(r));
+        } else if (ev->xproperty.atom == s.winstate_atoms[NUM_WINSTATES]) {
+            record_value r = {.window = w->id, .value = w->state};
+            record_write(RECORD_WINSTATE, &r, sizeof(r));
+        }
+        break;
+    default:
+        if (ev->type == s.damage_event + XDamageNotify) {
+            XDamageNotifyEvent *de = (XDamageNotifyEvent *) ev;
+            record_area r = {.window = de->drawable};
+            COPY_AREA(&r, &de->area);
+            record_write(RECORD_DAMAGE, &r, sizeof(r));
+        } else if (ev->type == s.xshape_event + ShapeNotify) {
+            XShapeEvent *se = (XShapeEvent *) ev;
+            if (se->kind != ShapeBounding)
+                break;
+            record_area r = {.window = se->window, .shaped = se->shaped};
+            COPY_AREA(&r, se);
+            record_write(RECORD_SHAPE, &r, sizeof(r));
+        }
+        break;
+    }
+}
+
+void record_close(void) {
+    if (!record_file)
+        return;
+    fclose(record_file);
+    record_file = NULL;
+}
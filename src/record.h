@@ -0,0 +1,105 @@
+#pragma once
+
+#include "window.h"
+#include <X11/Xlib.h>
+#include <stdint.h>
+
+/*
+ * event stream recording format
+ * a file starts with a record_header followed by records, each one being a record_entry
+ * followed by the payload matching its kind
+ * integers are stored in host byte order, recordings are meant to be replayed on the same architecture
+ */
+
+#define RECORD_MAGIC "AXREC"
+#define RECORD_VERSION 1
+
+typedef enum _record_kind {
+    RECORD_CREATE,
+    RECORD_CONFIGURE,
+    RECORD_DESTROY,
+    RECORD_MAP,
+    RECORD_UNMAP,
+    RECORD_REPARENT,
+    RECORD_CIRCULATE,
+    RECORD_DAMAGE,
+    RECORD_SHAPE,
+    RECORD_OPACITY,
+    RECORD_WINSTATE,
+    NUM_RECORD_KINDS
+} record_kind;
+
+typedef struct __attribute__((packed)) _record_header {
+    char magic[6];
+    uint16_t version;
+    uint16_t root_width;
+    uint16_t root_height;
+} record_header;
+
+typedef struct __attribute__((packed)) _record_entry {
+    uint8_t kind;
+    uint32_t delay; // microseconds since previous record, saturated
+} record_entry;
+
+typedef struct __attribute__((packed)) _record_geometry {
+    int16_t x, y;
+    uint16_t width, height, border_width;
+} record_geometry;
+
+typedef struct __attribute__((packed)) _record_create {
+    uint32_t window;
+    record_geometry geometry;
+    uint8_t override_redirect;
+    uint8_t depth; // 0 for InputOnly windows
+} record_create;
+
+typedef struct __attribute__((packed)) _record_configure {
+    uint32_t window;
+    uint32_t above;
+    record_geometry geometry;
+    uint8_t override_redirect;
+} record_configure;
+
+typedef struct __attribute__((packed)) _record_window {
+    uint32_t window; // destroy and unmap
+} record_window;
+
+typedef struct __attribute__((packed)) _record_map {
+    uint32_t window;
+    uint8_t window_type; // wintype, WINTYPE_UNKNOWN if not determined
+} record_map;
+
+typedef struct __attribute__((packed)) _record_reparent {
+    uint32_t window;
+    uint8_t to_root;
+} record_reparent;
+
+typedef struct __attribute__((packed)) _record_circulate {
+    uint32_t window;
+    uint8_t place;
+} record_circulate;
+
+typedef struct __attribute__((packed)) _record_area {
+    uint32_t window;
+    int16_t x, y;
+    uint16_t width, height;
+    uint8_t shaped; // only used by RECORD_SHAPE
+} record_area;
+
+typedef struct __attribute__((packed)) _record_value {
+    uint32_t window;
+    uint32_t value; // opacity as a cardinal or winstate bits
+} record_value;
+
+/*
+ * starts recording to path, the current window tree is written first so a replay can rebuild it,
+ * a recording in progress is closed first, returns False if path cannot be opened
+ */
+Bool record_open(const char *path);
+
+/*
+ * records ev after handle_event() processed it
+ */
+void record_event(XEvent *ev);
+
+void record_close(void);
@@ -1,39 +1,38 @@
+#include "render.h"
+#include "blur.h"
+#include "capture.h"
+#include "corner.h"
+#include "memory.h"
+#include "pool.h"
+#include "present.h"
+#include "scene.h"
 #include "session.h"
+#include "shadow.h"
+#include "stats.h"
 #include "string.h"
 #include "util.h"
 #include <X11/Xlib.h>
 #include <X11/extensions/Xcomposite.h>
 #include <X11/extensions/Xrender.h>
 
-/* 
- * scales window down relative to its center
- * upscaling doesn't work maybe because damage is not added
- */
-static void centered_scale(win *w, XRectangle *geometry) {
-    if (w->scale > 1.0) // TODO for now only downscaling is supported so we force max scale to 1
-        w->scale = 1.0;
-
-    double offset_x = (geometry->width - (geometry->width * w->scale)) / 2.0; // use abs(wid - (wid * scale)) / 2.0 for upscale support
-    double offset_y = (geometry->height - (geometry->height * w->scale)) / 2.0;
+// 1x1 A8 masks applying window opacity, indexed by the 8 bits opacity they hold
+static Picture alpha_pictures[256];
 
-    // scale transformation matrix
-    XTransform xform = {{{XDoubleToFixed(1.0), XDoubleToFixed(0.0), XDoubleToFixed(0.0)},
-                         {XDoubleToFixed(0.0), XDoubleToFixed(1.0), XDoubleToFixed(0.0)},
-                         {XDoubleToFixed(0.0), XDoubleToFixed(0.0), XDoubleToFixed(w->scale)}}};
+// 1x1 translucent black painted over inactive windows and the opacity it was made for
+static Picture dim_picture = None;
+static int dim_alpha = 0;
 
-    XRenderSetPictureFilter(s.dpy, w->picture, FilterBest, NULL, 0); // antialias scaled picture
-    XRenderSetPictureTransform(s.dpy, w->picture, &xform);
+static Pixmap buffer_pixmap = None; // kept for capture, which reads pixmaps
+static int buffer_width, buffer_height;
 
-    geometry->width *= w->scale;
-    geometry->height *= w->scale;
-    geometry->x += offset_x;
-    geometry->y += offset_y;
-}
+// snapshots of a desktop switch (see src/desktop.h), the windows are painted into the incoming one
+static Picture outgoing = None, incoming = None;
+static int snapshot_width, snapshot_height;
 
 void add_damage(XserverRegion damage) {
     if (s.all_damage) {
         XFixesUnionRegion(s.dpy, s.all_damage, s.all_damage, damage);
-        XFixesDestroyRegion(s.dpy, damage);
+        region_put(&event_regions, damage);
     } else
         s.all_damage = damage;
 }
@@ -44,17 +43,17 @@ static Picture solid_picture(Bool argb, double a, double r, double g, double b)
     XRenderPictureAttributes pa;
     XRenderColor c;
 
-    pixmap = XCreatePixmap(s.dpy, s.root, 1, 1, argb ? 32 : 8);
+    pixmap = XCreatePixmap(s.render_dpy, s.root, 1, 1, argb ? 32 : 8);
     if (!pixmap)
         return None;
 
     pa.repeat = True;
-    picture = XRenderCreatePicture(s.dpy, pixmap,
-                                   XRenderFindStandardFormat(s.dpy, argb ? PictStandardARGB32 : PictStandardA8),
+    picture = XRenderCreatePicture(s.render_dpy, pixmap,
+                                   XRenderFindStandardFormat(s.render_dpy, argb ? PictStandardARGB32 : PictStandardA8),
                                    CPRepeat,
                                    &pa);
     if (!picture) {
-        XFreePixmap(s.dpy, pixmap);
+        XFreePixmap(s.render_dpy, pixmap);
         return None;
     }
 
@@ -62,11 +61,35 @@ static Picture solid_picture(Bool argb, double a, double r, double g, double b)
     c.red = r * 0xffff;
     c.green = g * 0xffff;
     c.blue = b * 0xffff;
-    XRenderFillRectangle(s.dpy, PictOpSrc, picture, &c, 0, 0, 1, 1);
-    XFreePixmap(s.dpy, pixmap);
+    XRenderFillRectangle(s.render_dpy, PictOpSrc, picture, &c, 0, 0, 1, 1);
+    XFreePixmap(s.render_dpy, pixmap);
     return picture;
 }
 
+static Picture get_alpha_picture(double opacity) {
+    int alpha = opacity * 0xff + 0.5;
+    if (alpha >= 0xff)
+        return None;
+    if (alpha < 0)
+        alpha = 0;
+    if (!alpha_pictures[alpha])
+        alpha_pictures[alpha] = solid_picture(False, alpha / (double) 0xff, 0, 0, 0);
+    return alpha_pictures[alpha];
+}
+
+static Picture get_dim_picture(double dim) {
+    int alpha = dim * 0xff + 0.5;
+    if (dim_picture && alpha != dim_alpha) {
+        XRenderFreePicture(s.render_dpy, dim_picture);
+        dim_picture = None;
+    }
+    if (!dim_picture) {
+        dim_picture = solid_picture(True, alpha / (double) 0xff, 0, 0, 0);
+        dim_alpha = alpha;
+    }
+    return dim_picture;
+}
+
 /*
  * render root window
  * first get root window pixmap (to draw background image)
@@ -85,10 +108,10 @@ static Picture make_root_tile(void) {
 
     pixmap = None;
     for (int p = 0; p < 2; p++) { // 2 is s.background_atoms length
-        if (XGetWindowProperty(s.dpy, s.root, s.background_atoms[p],
+        if (XGetWindowProperty(s.render_dpy, s.root, s.background_atoms[p],
                                0, 4, False, AnyPropertyType,
                                &actual_type, &actual_format, &nitems, &bytes_after, &prop) == Success &&
-            actual_type == XInternAtom(s.dpy, "PIXMAP", False) && actual_format == 32 && nitems == 1) {
+            actual_type == XInternAtom(s.render_dpy, "PIXMAP", False) && actual_format == 32 && nitems == 1) {
             memcpy(&pixmap, prop, 4);
             XFree(prop);
             fill = False;
@@ -96,179 +119,668 @@ static Picture make_root_tile(void) {
         }
     }
     if (!pixmap) {
-        pixmap = XCreatePixmap(s.dpy, s.root, 1, 1, DefaultDepth(s.dpy, s.screen));
+        pixmap = XCreatePixmap(s.render_dpy, s.root, 1, 1, DefaultDepth(s.render_dpy, s.screen));
         fill = True;
     }
     pa.repeat = True;
-    picture = XRenderCreatePicture(s.dpy, pixmap,
-                                   XRenderFindVisualFormat(s.dpy,
-                                                           DefaultVisual(s.dpy, s.screen)),
+    picture = XRenderCreatePicture(s.render_dpy, pixmap,
+                                   XRenderFindVisualFormat(s.render_dpy,
+                                                           DefaultVisual(s.render_dpy, s.screen)),
                                    CPRepeat, &pa);
     if (fill) {
         XRenderColor c;
 
         c.red = c.green = c.blue = 0x8080;
         c.alpha = 0xffff;
-        XRenderFillRectangle(s.dpy, PictOpSrc, picture, &c,
+        XRenderFillRectangle(s.render_dpy, PictOpSrc, picture, &c,
                              0, 0, 1, 1);
     }
     return picture;
 }
 
-static void paint_root(void) {
-    if (!s.root_tile)
-        s.root_tile = make_root_tile();
+#define CLIP_UNKNOWN ((XserverRegion) -1)
 
-    XRenderComposite(s.dpy, PictOpSrc,
-                     s.root_tile, None, s.root_buffer,
-                     0, 0, 0, 0, 0, 0, s.root_width, s.root_height);
-}
+typedef enum _render_cmd_type {
+    CMD_COMPOSITE,
+    CMD_BLUR // composites the blurred background of w, which is computed when the command is submitted
+} render_cmd_type;
 
 /*
- * region is None if window is not solid
+ * a drawing operation into s.root_buffer
+ * a frame is built as a list of commands which is optimized then submitted
  */
-static void paint_window(win *w, XserverRegion region) {
-    XRectangle w_geo = {
-        .x = w->attr.x,
-        .y = w->attr.y,
-        .width = w->attr.width + w->attr.border_width * 2,
-        .height = w->attr.height + w->attr.border_width * 2};
+typedef struct _render_cmd {
+    render_cmd_type type;
+    int op;
+    Picture src;
+    Picture mask;
+    XserverRegion clip;   // clip of s.root_buffer, must not change until the list is submitted
+    Bool transform;       // src is scaled by scale_x and scale_y
+    Bool reset_transform; // src is shared between windows, its transform is reset after the composite
+    double scale_x, scale_y;
+    int src_x, src_y;
+    int mask_x, mask_y;
+    XRectangle dst;
+    Bool ignore_errors; // src is the picture of a window that may be destroyed since the scene was built
+    scene_win *w;       // CMD_BLUR only
+} render_cmd;
+
+static render_cmd *cmds = NULL;
+static int n_cmds = 0, size_cmds = 0;
+
+// regions holding the clips of the commands of a frame, given back to the pool once it is submitted
+static XserverRegion *frame_regions = NULL;
+static int n_frame_regions = 0, size_frame_regions = 0;
+
+// damage of the frame being built, commands outside of it are dropped
+static XRectangle *damage_rects = NULL;
+static int n_damage_rects = 0;
+
+static XserverRegion corner_region = None;
+
+// window pictures left with a scale transform by a previous command
+static Picture *scaled_pictures = NULL;
+static int n_scaled_pictures = 0, size_scaled_pictures = 0;
+
+static XserverRegion frame_region(void) {
+    if (n_frame_regions == size_frame_regions)
+        frame_regions = erealloc(frame_regions, (size_frame_regions += 32) * sizeof(XserverRegion));
+    return frame_regions[n_frame_regions++] = region_scratch(&render_regions);
+}
 
-    if (w->action_running && !w->need_effect)
-        w->need_effect = True;
+static Bool is_damaged(XRectangle *r) {
+    for (int i = 0; i < n_damage_rects; i++) {
+        XRectangle *d = &damage_rects[i];
+        if (r->x < d->x + d->width && d->x < r->x + r->width && r->y < d->y + d->height && d->y < r->y + r->height)
+            return True;
+    }
+    return False;
+}
 
-    if (w->need_effect) {
-        centered_scale(w, &w_geo);
+static render_cmd *push_cmd(render_cmd_type type, int op, Picture src, Picture mask, XserverRegion clip,
+                            XRectangle *dst) {
+    if (n_cmds == size_cmds)
+        cmds = erealloc(cmds, (size_cmds += 256) * sizeof(render_cmd));
+    render_cmd *c = &cmds[n_cmds++];
+    c->type = type;
+    c->op = op;
+    c->src = src;
+    c->mask = mask;
+    c->clip = clip;
+    c->transform = False;
+    c->reset_transform = False;
+    c->scale_x = c->scale_y = 1.0;
+    c->src_x = c->src_y = 0;
+    c->mask_x = c->mask_y = 0;
+    c->dst = *dst;
+    c->ignore_errors = False;
+    c->w = NULL;
+    return c;
+}
 
-        w_geo.x += w->offset_x;
-        w_geo.y += w->offset_y;
+/*
+ * returns the scale applied to w by an effect
+ * upscaling doesn't work maybe because damage is not added
+ */
+static double effect_scale(scene_win *w) {
+    if (!w->need_effect || w->scale > 1.0) // TODO for now only downscaling is supported so we force max scale to 1
+        return 1.0;
+    return w->scale;
+}
 
-        if (!w->action_running)
-            w->need_effect = False;
+/*
+ * returns the scale w->picture is painted with, a window whose move or resize is animated is stretched
+ * from the size of its previous contents to its geometry
+ */
+static void window_scale(scene_win *w, double *scale_x, double *scale_y) {
+    if (w->morph) {
+        *scale_x = effect_scale(w) * w->geometry.width / w->morph_width;
+        *scale_y = effect_scale(w) * w->geometry.height / w->morph_height;
+    } else {
+        *scale_x = *scale_y = effect_scale(w);
     }
+}
+
+/*
+ * scales geometry down relative to its center
+ */
+static void centered_scale(double scale, XRectangle *geometry) {
+    double offset_x = (geometry->width - (geometry->width * scale)) / 2.0; // use abs(wid - (wid * scale)) / 2.0 for upscale support
+    double offset_y = (geometry->height - (geometry->height * scale)) / 2.0;
 
-    if (region) { // solid window
-        XFixesSetPictureClipRegion(s.dpy, s.root_buffer, 0, 0, region);
-        set_ignore(NextRequest(s.dpy));
-        XFixesSubtractRegion(s.dpy, region, region, w->border_size);
+    geometry->width *= scale;
+    geometry->height *= scale;
+    geometry->x += offset_x;
+    geometry->y += offset_y;
+}
 
-        set_ignore(NextRequest(s.dpy));
-        XRenderComposite(s.dpy, PictOpSrc, w->picture, None, s.root_buffer,
-                         0, 0, 0, 0,
-                         w_geo.x, w_geo.y, w_geo.width, w_geo.height);
-    } else {
-        XFixesIntersectRegion(s.dpy, w->border_clip, w->border_clip, w->border_size);
-        XFixesSetPictureClipRegion(s.dpy, s.root_buffer, 0, 0, w->border_clip);
+static void set_scale_transform(Picture picture, double scale_x, double scale_y) {
+    // scale transformation matrix, it maps the destination to the source
+    XTransform xform = {{{XDoubleToFixed(1.0 / scale_x), XDoubleToFixed(0.0), XDoubleToFixed(0.0)},
+                         {XDoubleToFixed(0.0), XDoubleToFixed(1.0 / scale_y), XDoubleToFixed(0.0)},
+                         {XDoubleToFixed(0.0), XDoubleToFixed(0.0), XDoubleToFixed(1.0)}}};
+
+    XRenderSetPictureFilter(s.render_dpy, picture, FilterBest, NULL, 0); // antialias scaled picture
+    XRenderSetPictureTransform(s.render_dpy, picture, &xform);
+}
+
+/*
+ * returns the geometry w is painted at
+ */
+static void effect_geometry(scene_win *w, XRectangle *w_geo) {
+    *w_geo = w->geometry;
 
-        // creates w->alpha_picture mask to apply window opacity
-        if (w->opacity < 1.0 && !w->alpha_picture)
-            w->alpha_picture = solid_picture(False, w->opacity, 0, 0, 0);
+    if (w->need_effect) {
+        centered_scale(effect_scale(w), w_geo);
 
-        set_ignore(NextRequest(s.dpy));
-        XRenderComposite(s.dpy, PictOpOver, w->picture, w->alpha_picture, s.root_buffer,
-                         0, 0, 0, 0,
-                         w_geo.x, w_geo.y, w_geo.width, w_geo.height);
+        w_geo->x += w->offset_x;
+        w_geo->y += w->offset_y;
     }
 }
 
-void paint_all(XserverRegion region) {
-    win *w;
-    win *t = NULL;
+static void shadow_geometry(scene_win *w, XRectangle *s_geo) {
+    s_geo->x = w->geometry.x + s.shadow_offset_x - s.shadow_radius;
+    s_geo->y = w->geometry.y + s.shadow_offset_y - s.shadow_radius;
+    s_geo->width = w->geometry.width + s.shadow_radius * 2;
+    s_geo->height = w->geometry.height + s.shadow_radius * 2;
 
-    if (!region) {
-        XRectangle r;
-        r.x = 0;
-        r.y = 0;
-        r.width = s.root_width;
-        r.height = s.root_height;
-        region = XFixesCreateRegion(s.dpy, &r, 1);
+    if (w->need_effect) {
+        centered_scale(effect_scale(w), s_geo);
+        s_geo->x += w->offset_x;
+        s_geo->y += w->offset_y;
     }
+}
 
-    if (!s.root_buffer) {
-        Pixmap rootPixmap = XCreatePixmap(s.dpy, s.root, s.root_width, s.root_height,
-                                          DefaultDepth(s.dpy, s.screen));
-        s.root_buffer = XRenderCreatePicture(s.dpy, rootPixmap,
-                                             XRenderFindVisualFormat(s.dpy,
-                                                                     DefaultVisual(s.dpy, s.screen)),
-                                             0, NULL);
-        XFreePixmap(s.dpy, rootPixmap);
+/*
+ * returns the corner radius of a window painted at geometry, a radius never exceeds half its size
+ */
+static int corner_radius(scene_win *w, XRectangle *geometry) {
+    int r = w->corner_radius;
+    if (r > geometry->width / 2)
+        r = geometry->width / 2;
+    if (r > geometry->height / 2)
+        r = geometry->height / 2;
+    return r;
+}
+
+/*
+ * sets corner_region to the four r x r corner squares of geometry
+ */
+static void set_corner_region(XRectangle *geometry, int r) {
+    XRectangle rects[4] = {
+        {geometry->x, geometry->y, r, r},
+        {geometry->x + geometry->width - r, geometry->y, r, r},
+        {geometry->x, geometry->y + geometry->height - r, r, r},
+        {geometry->x + geometry->width - r, geometry->y + geometry->height - r, r, r}};
+
+    if (!corner_region)
+        corner_region = XFixesCreateRegion(s.render_dpy, NULL, 0);
+    XFixesSetRegion(s.render_dpy, corner_region, rects, 4);
+}
+
+static void push_window(scene_win *w, XRectangle *w_geo, int op, Picture mask, XserverRegion clip) {
+    render_cmd *c = push_cmd(CMD_COMPOSITE, op, w->picture, mask, clip, w_geo);
+    c->transform = w->need_effect || w->morph;
+    window_scale(w, &c->scale_x, &c->scale_y);
+    c->ignore_errors = True;
+}
+
+/*
+ * darkens w painted at geometry, mask restricts it to the window pixels
+ */
+static void push_dim(scene_win *w, XRectangle *w_geo, Picture mask, XserverRegion clip) {
+    push_cmd(CMD_COMPOSITE, PictOpOver, get_dim_picture(w->dim), mask, clip, w_geo)->ignore_errors = True;
+}
+
+/*
+ * paints the four corners of w at geometry through a shared disk mask
+ */
+static void push_corners(scene_win *w, XRectangle *w_geo, int r, XserverRegion clip) {
+    Picture mask = corner_mask(r, get_alpha_picture(w->opacity));
+
+    // quarter i of the disk is the mask of corner i
+    for (int i = 0; i < 4; i++) {
+        int x = i & 1 ? w_geo->width - r : 0;
+        int y = i & 2 ? w_geo->height - r : 0;
+        XRectangle dst = {w_geo->x + x, w_geo->y + y, r, r};
+
+        render_cmd *c = push_cmd(CMD_COMPOSITE, PictOpOver, w->picture, mask, clip, &dst);
+        c->transform = w->need_effect || w->morph;
+        window_scale(w, &c->scale_x, &c->scale_y);
+        c->src_x = x;
+        c->src_y = y;
+        c->mask_x = i & 1 ? r : 0;
+        c->mask_y = i & 2 ? r : 0;
+        c->ignore_errors = True;
+        if (w->dim) {
+            c = push_cmd(CMD_COMPOSITE, PictOpOver, get_dim_picture(w->dim), mask, clip, &dst);
+            c->mask_x = i & 1 ? r : 0;
+            c->mask_y = i & 2 ? r : 0;
+        }
     }
+}
+
+/*
+ * paints the shadow of w clipped to w->border_clip, must be called before painting w
+ */
+static void push_shadow(scene_win *w) {
+    XRectangle s_geo;
+    shadow_geometry(w, &s_geo);
+    if (!is_damaged(&s_geo))
+        return;
+
+    // the shadow of the previous size is stretched like the window while its move or resize is animated
+    int width = w->morph ? w->morph_width : w->geometry.width;
+    int height = w->morph ? w->morph_height : w->geometry.height;
+    Picture shadow = shadow_picture(width, height);
+    if (!shadow)
+        return;
+
+    // a shadow never shows through its own window
+    XserverRegion clip = frame_region();
+    set_ignore(NextRequest(s.render_dpy));
+    XFixesSubtractRegion(s.render_dpy, clip, w->border_clip, w->border_size);
+
+    // shadow pictures are shared between windows of the same size, a scale transform is only set for this composite
+    render_cmd *c = push_cmd(CMD_COMPOSITE, PictOpOver, shadow, get_alpha_picture(w->opacity), clip, &s_geo);
+    if (w->morph) {
+        c->scale_x = s_geo.width / (double) (width + s.shadow_radius * 2);
+        c->scale_y = s_geo.height / (double) (height + s.shadow_radius * 2);
+    } else {
+        c->scale_x = c->scale_y = effect_scale(w);
+    }
+    c->transform = c->reset_transform = c->scale_x != 1.0 || c->scale_y != 1.0;
+}
 
-    XFixesSetPictureClipRegion(s.dpy, s.root_picture, 0, 0, region);
+/*
+ * solid windows and the opaque region of ARGB windows, top to bottom
+ * region loses what each window hides, w->border_clip is what is left of it above w
+ */
+static void build_opaque(scene *sc, XserverRegion region) {
+    // what is left of region above the current window, shared by the windows until the next opaque one
+    XserverRegion clip = frame_region();
+    XFixesCopyRegion(s.render_dpy, clip, region);
 
-    // draw solid windows into root_buffer
-    for (w = s.managed_windows; w; w = w->next) {
-        /* never painted, ignore it */
-        if (!w->damaged)
-            continue;
-        /* if invisible, ignore it */
-        if (w->attr.x + w->attr.width < 1 || w->attr.y + w->attr.height < 1 || w->attr.x >= s.root_width || w->attr.y >= s.root_height)
+    for (int i = 0; i < sc->n_windows; i++) {
+        scene_win *w = &sc->windows[i];
+        w->border_clip = None;
+
+        XRectangle w_geo, bounds;
+        effect_geometry(w, &w_geo);
+        bounds = w_geo;
+        if (w->shadow) {
+            XRectangle s_geo;
+            shadow_geometry(w, &s_geo);
+            if (s_geo.x < bounds.x) {
+                bounds.width += bounds.x - s_geo.x;
+                bounds.x = s_geo.x;
+            }
+            if (s_geo.y < bounds.y) {
+                bounds.height += bounds.y - s_geo.y;
+                bounds.y = s_geo.y;
+            }
+            if (s_geo.x + s_geo.width > bounds.x + bounds.width)
+                bounds.width = s_geo.x + s_geo.width - bounds.x;
+            if (s_geo.y + s_geo.height > bounds.y + bounds.height)
+                bounds.height = s_geo.y + s_geo.height - bounds.y;
+        }
+        // nothing of this window is painted, it does not change the clip of the windows below
+        if (!is_damaged(&bounds)) {
+            if (w->blur) {
+                blur_touch(w->id);
+                if (w->blur_dirty)
+                    blur_invalidate(w->id);
+            }
             continue;
-        if (!w->picture) {
-            XRenderPictureAttributes pa;
-            XRenderPictFormat *format;
-            Drawable draw = w->id;
-
-            if (!w->pixmap)
-                w->pixmap = XCompositeNameWindowPixmap(s.dpy, w->id);
-            if (w->pixmap)
-                draw = w->pixmap;
-
-            format = XRenderFindVisualFormat(s.dpy, w->attr.visual);
-            pa.subwindow_mode = IncludeInferiors;
-            w->picture = XRenderCreatePicture(s.dpy, draw,
-                                              format,
-                                              CPSubwindowMode,
-                                              &pa);
         }
 
-        if (s.clip_changed) {
-            if (w->border_size) {
-                set_ignore(NextRequest(s.dpy));
-                XFixesDestroyRegion(s.dpy, w->border_size);
-                w->border_size = None;
+        if (w->mode == WINDOW_SOLID || w->opaque_region) {
+            // part of the window hiding what is below it
+            XserverRegion opaque = w->mode == WINDOW_SOLID ? w->border_size : w->opaque_region;
+            XserverRegion paint_clip = clip;
+            int r = corner_radius(w, &w_geo);
+            if (r) {
+                // the corners are painted over what is below by build_translucent()
+                set_corner_region(&w_geo, r);
+                set_ignore(NextRequest(s.render_dpy));
+                XFixesSubtractRegion(s.render_dpy, corner_region, opaque, corner_region);
+                opaque = corner_region;
             }
-            if (w->extents) {
-                XFixesDestroyRegion(s.dpy, w->extents);
-                w->extents = None;
+            if (opaque != w->border_size) {
+                paint_clip = frame_region();
+                XFixesIntersectRegion(s.render_dpy, paint_clip, region, opaque);
             }
-            if (w->border_clip) {
-                XFixesDestroyRegion(s.dpy, w->border_clip);
-                w->border_clip = None;
+
+            push_window(w, &w_geo, PictOpSrc, None, paint_clip);
+            if (w->dim)
+                push_dim(w, &w_geo, None, paint_clip);
+
+            set_ignore(NextRequest(s.render_dpy));
+            XFixesSubtractRegion(s.render_dpy, region, region, opaque);
+            clip = frame_region();
+            XFixesCopyRegion(s.render_dpy, clip, region);
+        }
+        w->border_clip = clip;
+    }
+}
+
+/*
+ * shadows, blurred backgrounds, translucent windows and corners, bottom to top
+ */
+static void build_translucent(scene *sc) {
+    for (int i = sc->n_windows - 1; i >= 0; i--) {
+        scene_win *w = &sc->windows[i];
+        if (!w->border_clip)
+            continue;
+
+        if (w->shadow)
+            push_shadow(w);
+
+        XRectangle w_geo;
+        effect_geometry(w, &w_geo);
+        int r = corner_radius(w, &w_geo);
+        Bool translucent = w->mode == WINDOW_TRANS || w->mode == WINDOW_ARGB;
+        if ((!translucent && !r) || !is_damaged(&w_geo))
+            continue;
+
+        XserverRegion clip = frame_region();
+        set_ignore(NextRequest(s.render_dpy));
+        XFixesIntersectRegion(s.render_dpy, clip, w->border_clip, w->border_size);
+
+        if (translucent) {
+            XserverRegion inner = clip;
+            if (r) {
+                set_corner_region(&w_geo, r);
+                inner = frame_region();
+                XFixesSubtractRegion(s.render_dpy, inner, clip, corner_region);
             }
+
+            // the blurred background is not transformed, skip it while the window is scaled or moved by an effect
+            if (w->blur && !w->morph && !(w->need_effect && (w->scale != 1.0 || w->offset_x || w->offset_y)))
+                push_cmd(CMD_BLUR, PictOpSrc, None, None, inner, &w->geometry)->w = w;
+
+            push_window(w, &w_geo, PictOpOver, get_alpha_picture(w->opacity), inner);
+            // the alpha channel of an ARGB window keeps its transparent pixels undimmed
+            if (w->dim)
+                push_dim(w, &w_geo, w->mode == WINDOW_ARGB ? w->picture : get_alpha_picture(w->opacity), inner);
         }
-        if (!w->border_size)
-            w->border_size = border_size(w);
-        if (!w->extents)
-            w->extents = win_extents(w);
-        if (w->mode == WINDOW_SOLID)
-            paint_window(w, region);
-
-        if (!w->border_clip) {
-            w->border_clip = XFixesCreateRegion(s.dpy, NULL, 0);
-            XFixesCopyRegion(s.dpy, w->border_clip, region);
+
+        if (r)
+            push_corners(w, &w_geo, r, clip);
+    }
+}
+
+/*
+ * drops the commands outside of the damage
+ */
+static void optimize_cmds(void) {
+    int n = 0;
+
+    for (int i = 0; i < n_cmds; i++) {
+        render_cmd *c = &cmds[i];
+        // the clip of a command outside of the damage is empty
+        if (!is_damaged(&c->dst)) {
+            atomic_fetch_add_explicit(&stats.dropped_commands, 1, memory_order_relaxed);
+            continue;
         }
-        w->prev_trans = t;
-        t = w;
+        cmds[n++] = *c;
     }
+    n_cmds = n;
+}
 
-    XFixesSetPictureClipRegion(s.dpy, s.root_buffer, 0, 0, region);
-    paint_root();
+/*
+ * sets the transform of the window picture c->src, a picture left scaled is reset the next time it is painted
+ * unscaled, whatever scenes or commands were skipped since its effect ended
+ */
+static void set_window_transform(render_cmd *c) {
+    Bool scaled = c->transform && (c->scale_x != 1.0 || c->scale_y != 1.0);
+    int i = 0;
+    while (i < n_scaled_pictures && scaled_pictures[i] != c->src)
+        i++;
+
+    if (scaled) {
+        set_scale_transform(c->src, c->scale_x, c->scale_y);
+        if (i == n_scaled_pictures) {
+            if (n_scaled_pictures == size_scaled_pictures)
+                scaled_pictures = erealloc(scaled_pictures, (size_scaled_pictures += 16) * sizeof(Picture));
+            scaled_pictures[n_scaled_pictures++] = c->src;
+        }
+    } else if (i < n_scaled_pictures) {
+        set_scale_transform(c->src, 1.0, 1.0);
+        scaled_pictures[i] = scaled_pictures[--n_scaled_pictures];
+    }
+}
+
+void render_forget_picture(Picture picture) {
+    for (int i = 0; i < n_scaled_pictures; i++) {
+        if (scaled_pictures[i] == picture) {
+            scaled_pictures[i] = scaled_pictures[--n_scaled_pictures];
+            return;
+        }
+    }
+}
 
-    // draw non solid windows into root_buffer
-    for (w = t; w; w = w->prev_trans) {
-        XFixesSetPictureClipRegion(s.dpy, s.root_buffer, 0, 0, w->border_clip);
+static void submit_cmds(void) {
+    XserverRegion clip = CLIP_UNKNOWN;
 
-        if (w->mode == WINDOW_TRANS || w->mode == WINDOW_ARGB)
-            paint_window(w, None);
+    for (int i = 0; i < n_cmds; i++) {
+        render_cmd *c = &cmds[i];
 
-        XFixesDestroyRegion(s.dpy, w->border_clip);
-        w->border_clip = None;
+        if (c->type == CMD_BLUR) {
+            // the blur reads s.root_buffer, everything below the window is painted at this point
+            c->src = blur_background(c->w, c->w->blur_dirty);
+            clip = CLIP_UNKNOWN;
+        }
+        if (c->clip != clip) {
+            XFixesSetPictureClipRegion(s.render_dpy, s.root_buffer, 0, 0, c->clip);
+            clip = c->clip;
+        }
+        if (c->reset_transform)
+            set_scale_transform(c->src, c->scale_x, c->scale_y);
+        else if (c->type == CMD_COMPOSITE)
+            set_window_transform(c);
+
+        if (c->ignore_errors)
+            set_ignore(NextRequest(s.render_dpy));
+        XRenderComposite(s.render_dpy, c->op, c->src, c->mask, s.root_buffer,
+                         c->src_x, c->src_y, c->mask_x, c->mask_y,
+                         c->dst.x, c->dst.y, c->dst.width, c->dst.height);
+
+        if (c->reset_transform)
+            set_scale_transform(c->src, 1.0, 1.0);
     }
-    XFixesDestroyRegion(s.dpy, region);
-    if (s.root_buffer != s.root_picture) {
-        XFixesSetPictureClipRegion(s.dpy, s.root_buffer, 0, 0, None);
-        XRenderComposite(s.dpy, PictOpSrc, s.root_buffer, None, s.root_picture,
-                         0, 0, 0, 0, 0, 0, s.root_width, s.root_height);
+    atomic_fetch_add_explicit(&stats.commands, n_cmds, memory_order_relaxed);
+}
+
+static Picture snapshot_picture(int width, int height) {
+    Pixmap pixmap = XCreatePixmap(s.render_dpy, s.root, width, height, DefaultDepth(s.render_dpy, s.screen));
+    Picture picture = XRenderCreatePicture(s.render_dpy, pixmap,
+                                           XRenderFindVisualFormat(s.render_dpy,
+                                                                   DefaultVisual(s.render_dpy, s.screen)),
+                                           0, NULL);
+    XFreePixmap(s.render_dpy, pixmap);
+    memory_add(MEMORY_BUFFERS, memory_pixmap_bytes(width, height, DefaultDepth(s.render_dpy, s.screen)));
+    return picture;
+}
+
+static void free_snapshots(void) {
+    if (!incoming)
+        return;
+    XRenderFreePicture(s.render_dpy, outgoing);
+    XRenderFreePicture(s.render_dpy, incoming);
+    memory_add(MEMORY_BUFFERS, -2 * (long int) memory_pixmap_bytes(snapshot_width, snapshot_height,
+                                                                   DefaultDepth(s.render_dpy, s.screen)));
+    outgoing = incoming = None;
+}
+
+/*
+ * makes the snapshots when a desktop switch starts, the outgoing one is a copy of the last frame
+ * which s.root_buffer still holds, returns False if the switch cannot be painted from snapshots
+ */
+static Bool update_snapshots(scene *sc) {
+    if (!sc->desktop.running) {
+        free_snapshots();
+        return False;
     }
+    if (sc->desktop.start) {
+        free_snapshots();
+        if (!s.root_buffer)
+            return False;
+
+        snapshot_width = sc->root_width;
+        snapshot_height = sc->root_height;
+        outgoing = snapshot_picture(snapshot_width, snapshot_height);
+        incoming = snapshot_picture(snapshot_width, snapshot_height);
+        XFixesSetPictureClipRegion(s.render_dpy, s.root_buffer, 0, 0, None);
+        XRenderComposite(s.render_dpy, PictOpSrc, s.root_buffer, None, outgoing,
+                         0, 0, 0, 0, 0, 0, snapshot_width, snapshot_height);
+    }
+    // the incoming snapshot is only painted entirely when the switch starts
+    if (incoming && (snapshot_width != sc->root_width || snapshot_height != sc->root_height))
+        free_snapshots();
+    return incoming != None;
+}
+
+/*
+ * paints the two snapshots of a desktop switch over the whole screen
+ */
+static void push_snapshots(scene *sc, XserverRegion clip) {
+    desktop_transition *t = &sc->desktop;
+    XRectangle geo = {0, 0, snapshot_width, snapshot_height};
+
+    if (t->dx || t->dy) {
+        // the incoming desktop takes the place the outgoing one leaves
+        XRectangle out = geo, in = geo;
+        out.x = t->dx * t->progress * snapshot_width;
+        out.y = t->dy * t->progress * snapshot_height;
+        in.x = out.x - t->dx * snapshot_width;
+        in.y = out.y - t->dy * snapshot_height;
+        push_cmd(CMD_COMPOSITE, PictOpSrc, outgoing, None, clip, &out);
+        push_cmd(CMD_COMPOSITE, PictOpSrc, incoming, None, clip, &in);
+    } else {
+        push_cmd(CMD_COMPOSITE, PictOpSrc, incoming, None, clip, &geo);
+        push_cmd(CMD_COMPOSITE, PictOpOver, outgoing, get_alpha_picture(1.0 - t->progress), clip, &geo);
+    }
+}
+
+void render_init(void) {
+    XRenderPictureAttributes pa;
+
+    if (s.present && (s.present = present_init()))
+        return;
+
+    pa.subwindow_mode = IncludeInferiors;
+    s.root_picture = XRenderCreatePicture(s.render_dpy, s.root,
+                                          XRenderFindVisualFormat(s.render_dpy,
+                                                                  DefaultVisual(s.render_dpy, s.screen)),
+                                          CPSubwindowMode,
+                                          &pa);
+}
+
+void paint_all(scene *sc) {
+    XserverRegion region = sc->damage;
+    XRectangle root_geo = {0, 0, sc->root_width, sc->root_height};
+
+    stats_frame_start();
+
+    if (sc->root_tile_changed && s.root_tile) {
+        XRenderFreePicture(s.render_dpy, s.root_tile);
+        s.root_tile = None;
+    }
+
+    n_frame_regions = 0;
+
+    // while a desktop switch runs the damage is painted into the incoming snapshot, the frame is the whole screen
+    Bool snapshots = update_snapshots(sc);
+    XserverRegion frame = region;
+    if (snapshots) {
+        frame = frame_region();
+        XFixesSetRegion(s.render_dpy, frame, &root_geo, 1);
+    }
+
+    // capture only needs the damage of the frame, present_buffer() adds the one the back buffer missed
+    XRectangle *capture_rects = NULL;
+    int n_capture_rects = 0;
+    if (s.capture && (s.present || snapshots))
+        capture_rects = XFixesFetchRegion(s.render_dpy, frame, &n_capture_rects);
+
+    if (s.present)
+        s.root_buffer = present_buffer(frame, sc->root_width, sc->root_height);
+
+    if (!s.present && s.root_buffer && (buffer_width != sc->root_width || buffer_height != sc->root_height)) {
+        XRenderFreePicture(s.render_dpy, s.root_buffer);
+        XFreePixmap(s.render_dpy, buffer_pixmap);
+        memory_add(MEMORY_BUFFERS,
+                   -(long int) memory_pixmap_bytes(buffer_width, buffer_height, DefaultDepth(s.render_dpy, s.screen)));
+        s.root_buffer = None;
+    }
+
+    if (!s.present && !s.root_buffer) {
+        buffer_pixmap = XCreatePixmap(s.render_dpy, s.root, sc->root_width, sc->root_height,
+                                      DefaultDepth(s.render_dpy, s.screen));
+        s.root_buffer = XRenderCreatePicture(s.render_dpy, buffer_pixmap,
+                                             XRenderFindVisualFormat(s.render_dpy,
+                                                                     DefaultVisual(s.render_dpy, s.screen)),
+                                             0, NULL);
+        buffer_width = sc->root_width;
+        buffer_height = sc->root_height;
+        memory_add(MEMORY_BUFFERS,
+                   memory_pixmap_bytes(buffer_width, buffer_height, DefaultDepth(s.render_dpy, s.screen)));
+    }
+
+    if (!s.present)
+        XFixesSetPictureClipRegion(s.render_dpy, s.root_picture, 0, 0, frame);
+
+    damage_rects = XFixesFetchRegion(s.render_dpy, region, &n_damage_rects);
+    n_cmds = 0;
+
+    Picture target = s.root_buffer;
+    if (snapshots)
+        s.root_buffer = incoming;
+
+    build_opaque(sc, region);
+
+    if (!s.root_tile)
+        s.root_tile = make_root_tile();
+    push_cmd(CMD_COMPOSITE, PictOpSrc, s.root_tile, None, region, &root_geo);
+
+    build_translucent(sc);
+    optimize_cmds();
+    submit_cmds();
+
+    if (snapshots) {
+        s.root_buffer = target;
+        n_cmds = 0;
+        push_snapshots(sc, frame);
+        submit_cmds();
+    }
+
+    if (s.capture) {
+        Drawable d = s.present ? present_pixmap() : buffer_pixmap;
+        if (capture_rects)
+            capture_publish(d, sc->root_width, sc->root_height, capture_rects, n_capture_rects);
+        else
+            capture_publish(d, sc->root_width, sc->root_height, damage_rects, n_damage_rects);
+    }
+
+    if (capture_rects)
+        XFree(capture_rects);
+    if (damage_rects)
+        XFree(damage_rects);
+    damage_rects = NULL;
+    n_damage_rects = 0;
+    for (int i = 0; i < n_frame_regions; i++)
+        region_put(&render_regions, frame_regions[i]);
+    if (s.present) {
+        present_frame();
+    } else if (s.root_buffer != s.root_picture) {
+        XFixesSetPictureClipRegion(s.render_dpy, s.root_buffer, 0, 0, None);
+        XRenderComposite(s.render_dpy, PictOpSrc, s.root_buffer, None, s.root_picture,
+                         0, 0, 0, 0, 0, 0, sc->root_width, sc->root_height);
+    }
+
+    blur_frame_end();
+    shadow_frame_end();
+    corner_frame_end();
+    stats_frame_end();
 }
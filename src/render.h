@@ -1,7 +1,21 @@
 #pragma once
 
+#include "scene.h"
 #include <X11/extensions/Xdamage.h>
 
 void add_damage(XserverRegion damage);
 
-void paint_all(XserverRegion region);
+/*
+ * creates the renderer resources on s.render_dpy, s.present is cleared if Present cannot be used
+ */
+void render_init(void);
+
+/*
+ * forgets what the renderer keeps about picture, which is being freed
+ */
+void render_forget_picture(Picture picture);
+
+/*
+ * paints sc into the root window using s.render_dpy, sc->damage is clobbered
+ */
+void paint_all(scene *sc);
@@ -0,0 +1,108 @@
+#include "retain.h"
+#include "memory.h"
+#include "scene.h"
+#include "session.h"
+#include "util.h"
+#include <X11/Xlib.h>
+#include <string.h>
+
+typedef struct _retained {
+    win *w;
+    Pixmap pixmap;
+    Picture picture;
+    int width, height; // with borders, the size of the pixmap
+    unsigned long int bytes;
+} retained;
+
+static retained *entries = NULL; // least recently unmapped first
+static int n_entries = 0, size_entries = 0;
+static unsigned long int total_bytes = 0;
+
+static int retain_find(win *w) {
+    for (int i = 0; i < n_entries; i++) {
+        if (entries[i].w == w)
+            return i;
+    }
+    return -1;
+}
+
+/*
+ * removes the entry i, freeing its contents unless they are given back to their window
+ */
+static void retain_remove(int i, Bool free_contents) {
+    if (free_contents) {
+        if (entries[i].picture)
+            scene_release_picture(entries[i].picture);
+        XFreePixmap(s.dpy, entries[i].pixmap);
+    }
+    total_bytes -= entries[i].bytes;
+    memory_add(MEMORY_RETAINED, -(long int) entries[i].bytes);
+    memmove(&entries[i], &entries[i + 1], (n_entries - i - 1) * sizeof(retained));
+    n_entries--;
+}
+
+void retain_put(win *w) {
+    int width = w->attr.width + w->attr.border_width * 2;
+    int height = w->attr.height + w->attr.border_width * 2;
+    unsigned long int bytes = w->pixmap_bytes;
+
+    memory_add(MEMORY_WINDOWS, -(long int) bytes);
+    if (!s.retain_budget || bytes > s.retain_budget) {
+        if (w->picture)
+            scene_release_picture(w->picture);
+        XFreePixmap(s.dpy, w->pixmap);
+    } else {
+        while (total_bytes + bytes > s.retain_budget)
+            retain_remove(0, True);
+        if (n_entries == size_entries)
+            entries = erealloc(entries, (size_entries += 16) * sizeof(retained));
+        entries[n_entries++] = (retained){w, w->pixmap, w->picture, width, height, bytes};
+        total_bytes += bytes;
+        memory_add(MEMORY_RETAINED, bytes);
+    }
+    w->pixmap = None;
+    w->picture = None;
+    w->pixmap_bytes = 0;
+}
+
+Bool retain_take(win *w) {
+    int i = retain_find(w);
+    if (i < 0)
+        return False;
+
+    // a window resized while unmapped is drawn at its new size, its old contents would be stretched
+    if (entries[i].width != w->attr.width + w->attr.border_width * 2 ||
+        entries[i].height != w->attr.height + w->attr.border_width * 2) {
+        retain_remove(i, True);
+        return False;
+    }
+    w->pixmap = entries[i].pixmap;
+    w->picture = entries[i].picture;
+    w->pixmap_bytes = entries[i].bytes;
+    memory_add(MEMORY_WINDOWS, w->pixmap_bytes);
+    retain_remove(i, False);
+    return True;
+}
+
+void retain_drop(win *w) {
+    int i = retain_find(w);
+    if (i >= 0)
+        retain_remove(i, True);
+}
+
+unsigned long int retain_evict(unsigned long int bytes) {
+    unsigned long int freed = 0;
+    while (n_entries && freed < bytes) {
+        freed += entries[0].bytes;
+        retain_remove(0, True);
+    }
+    return freed;
+}
+
+unsigned long int retain_bytes(void) {
+    return total_bytes;
+}
+
+int retain_count(void) {
+    return n_entries;
+}
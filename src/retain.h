@@ -0,0 +1,39 @@
+#pragma once
+
+#include "window.h"
+
+/*
+ * last contents of unmapped windows, kept so a remapped window is drawn before its client repaints it
+ * the pixmaps kept are bounded by s.retain_budget bytes, the least recently unmapped ones are freed first
+ * event thread only
+ */
+
+/*
+ * keeps the pixmap and picture of w, which is being unmapped, they are freed if they do not fit the budget
+ */
+void retain_put(win *w);
+
+/*
+ * gives w its retained contents back when it is mapped, returns False if it has none of its current size
+ */
+Bool retain_take(win *w);
+
+/*
+ * frees the retained contents of w, if any
+ */
+void retain_drop(win *w);
+
+/*
+ * frees the least recently unmapped contents until bytes were freed or none is left, returns the bytes freed
+ */
+unsigned long int retain_evict(unsigned long int bytes);
+
+/*
+ * returns the estimated server memory held by retained contents, in bytes
+ */
+unsigned long int retain_bytes(void);
+
+/*
+ * returns the number of windows whose contents are retained
+ */
+int retain_count(void);
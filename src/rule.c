@@ -0,0 +1,115 @@
+#include "rule.h"
+#include "util.h"
+#include <X11/Xlib.h>
+#include <regex.h>
+#include <stdlib.h>
+#include <string.h>
+
+static unsigned int hash(const char *str) {
+    unsigned int h = 5381;
+    while (*str)
+        h = h * 33 + (unsigned char) *str++;
+    return h % RULE_BUCKETS;
+}
+
+static void index_add(int **list, int *n, int index) {
+    // never more than a few rules per list, grown one at a time
+    *list = erealloc(*list, (*n + 1) * sizeof(int));
+    (*list)[(*n)++] = index;
+}
+
+rule_set *rule_set_new(void) {
+    return ecalloc(1, sizeof(rule_set));
+}
+
+void rule_set_free(rule_set *set) {
+    for (int i = 0; i < set->n_rules; i++) {
+        window_rule *r = &set->rules[i];
+        free(r->title);
+        free(r->class);
+        free(r->role);
+        if (r->name) {
+            regfree(r->name);
+            free(r->name);
+        }
+    }
+    for (int i = 0; i < RULE_BUCKETS; i++)
+        free(set->buckets[i]);
+    free(set->any);
+    free(set->rules);
+    free(set);
+}
+
+window_rule *rule_add(rule_set *set, const char *title, const char *class, const char *name, const char *role) {
+    window_rule rule = {0};
+
+    if (name) {
+        rule.name = ecalloc(1, sizeof(regex_t));
+        if (regcomp(rule.name, name, REG_EXTENDED | REG_NOSUB) != 0) {
+            free(rule.name);
+            return NULL;
+        }
+        set->uses_name = True;
+    }
+    rule.title = strdup(title);
+    rule.class = class ? strdup(class) : NULL;
+    rule.role = role ? strdup(role) : NULL;
+    rule.opacity = -1.0;
+    rule.shadow = -1;
+    rule.unredirect = -1;
+
+    if (class) {
+        unsigned int h = hash(class);
+        index_add(&set->buckets[h], &set->n_buckets[h], set->n_rules);
+        set->uses_class = True;
+    } else
+        index_add(&set->any, &set->n_any, set->n_rules);
+    if (role)
+        set->uses_role = True;
+
+    if (set->n_rules == set->size_rules)
+        set->rules = erealloc(set->rules, (set->size_rules += 8) * sizeof(window_rule));
+    set->rules[set->n_rules] = rule;
+    return &set->rules[set->n_rules++];
+}
+
+static Bool rule_matches(window_rule *r, const char *instance, const char *class, const char *name,
+                         const char *role) {
+    if (r->class && !((instance && strcmp(r->class, instance) == 0) || (class && strcmp(r->class, class) == 0)))
+        return False;
+    if (r->role && (!role || strcmp(r->role, role) != 0))
+        return False;
+    if (r->name && (!name || regexec(r->name, name, 0, NULL, 0) != 0))
+        return False;
+    return True;
+}
+
+/*
+ * lists are in config order, only the first match of a list can be better than *best
+ */
+static void match_list(rule_set *set, int *list, int n, const char *instance, const char *class,
+                       const char *name, const char *role, int *best) {
+    for (int i = 0; i < n && list[i] < *best; i++) {
+        if (rule_matches(&set->rules[list[i]], instance, class, name, role)) {
+            *best = list[i];
+            return;
+        }
+    }
+}
+
+const window_rule *rule_match(rule_set *set, const char *instance, const char *class, const char *name,
+                              const char *role) {
+    int best = set->n_rules;
+
+    if (instance) {
+        unsigned int h = hash(instance);
+        match_list(set, set->buckets[h], set->n_buckets[h], instance, class, name, role, &best);
+    }
+    if (class) {
+        unsigned int h = hash(class);
+        match_list(set, set->buckets[h], set->n_buckets[h], instance, class, name, role, &best);
+    }
+    match_list(set, set->any, set->n_any, instance, class, name, role, &best);
+
+    return best < set->n_rules ? &set->rules[best] : NULL;
+}
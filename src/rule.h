@@ -0,0 +1,47 @@
+#pragma once
+
+#include "effect.h"
+#include <X11/Xlib.h>
+#include <regex.h>
+
+#define RULE_BUCKETS 64 // hash buckets of the classes rules match exactly
+
+// effect-rules window section, the options it does not set keep the values of the window type
+typedef struct _window_rule {
+    char *title;
+    char *class; // WM_CLASS instance or class, NULL matches any
+    char *role;  // WM_WINDOW_ROLE, NULL matches any
+    regex_t *name;                      // extended regular expression searched in the window name, NULL matches any
+    effect *effects[NUM_EVENT_EFFECTS]; // NULL keeps the effect of the window type
+    double opacity;                     // default opacity, negative if not set
+    int shadow;                         // -1 if not set
+    int unredirect;                     // -1 if not set
+} window_rule;
+
+// window rules of a config, the first one of the config matching a window applies
+typedef struct _rule_set {
+    window_rule *rules;
+    int n_rules, size_rules;
+    int *buckets[RULE_BUCKETS]; // indices of the rules with a class, by class hash
+    int n_buckets[RULE_BUCKETS];
+    int *any; // indices of the rules without a class
+    int n_any;
+    Bool uses_class, uses_name, uses_role; // properties windows must be read for
+} rule_set;
+
+rule_set *rule_set_new(void);
+
+void rule_set_free(rule_set *set);
+
+/*
+ * adds a rule matching windows on the non NULL properties, the caller sets its other options
+ * returns NULL if name is not a valid regular expression
+ * the rule must be filled before the next rule_add() call, which may move it
+ */
+window_rule *rule_add(rule_set *set, const char *title, const char *class, const char *name, const char *role);
+
+/*
+ * returns the rule matching a window with these properties (NULL if unset) or NULL if none does
+ */
+const window_rule *rule_match(rule_set *set, const char *instance, const char *class, const char *name,
+                              const char *role);
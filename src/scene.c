@@ -0,0 +1,356 @@
+#include "scene.h"
+#include "blur.h"
+#include "desktop.h"
+#include "output.h"
+#include "pool.h"
+#include "render.h"
+#include "session.h"
+#include "stats.h"
+#include "util.h"
+#include "window.h"
+#include <X11/Xlib.h>
+#include <X11/extensions/Xfixes.h>
+#include <X11/extensions/Xrender.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#define SCENE_QUEUE_SIZE 4 // must be a power of 2
+#define SCENE_MAX_IN_FLIGHT 2
+
+/*
+ * single producer (event thread), single consumer (render thread) queue
+ * scenes[i] is owned by the event thread while it is not between queue_head and queue_tail
+ * the render thread only moves queue_head once the scenes it consumed are painted
+ */
+static scene scenes[SCENE_QUEUE_SIZE];
+static atomic_uint queue_head = 0, queue_tail = 0;
+static int wake_fd = -1; // event thread -> render thread
+
+// releases made since the last scene was built
+static scene_release *pending_releases = NULL;
+static int n_pending_releases = 0, size_pending_releases = 0;
+
+static XserverRegion full_screen_region(void) {
+    XRectangle r = {
+        .x = 0,
+        .y = 0,
+        .width = s.root_width,
+        .height = s.root_height};
+    return region_get(&event_regions, &r, 1);
+}
+
+static void release(release_type type, XID id) {
+    if (!s.render_thread) {
+        set_ignore(NextRequest(s.dpy));
+        if (type == RELEASE_PICTURE) {
+            render_forget_picture(id);
+            XRenderFreePicture(s.dpy, id);
+        } else if (type == RELEASE_REGION)
+            XFixesDestroyRegion(s.dpy, id);
+        else
+            region_put(&event_regions, id);
+        return;
+    }
+
+    if (n_pending_releases == size_pending_releases)
+        pending_releases = erealloc(pending_releases, (size_pending_releases += 64) * sizeof(scene_release));
+    pending_releases[n_pending_releases].type = type;
+    pending_releases[n_pending_releases].id = id;
+    n_pending_releases++;
+}
+
+void scene_release_picture(Picture picture) {
+    release(RELEASE_PICTURE, picture);
+}
+
+void scene_release_region(XserverRegion region) {
+    release(RELEASE_REGION, region);
+}
+
+void scene_recycle_region(XserverRegion region) {
+    release(RELEASE_POOLED_REGION, region);
+}
+
+// pooled regions are left to scene_reclaim(), the renderer has no access to the event thread pool
+static void scene_free_releases(scene *sc) {
+    for (int i = 0; i < sc->n_releases; i++) {
+        if (sc->releases[i].type == RELEASE_POOLED_REGION)
+            continue;
+        set_ignore(NextRequest(s.render_dpy));
+        if (sc->releases[i].type == RELEASE_PICTURE) {
+            render_forget_picture(sc->releases[i].id);
+            XRenderFreePicture(s.render_dpy, sc->releases[i].id);
+        } else
+            XFixesDestroyRegion(s.render_dpy, sc->releases[i].id);
+    }
+}
+
+/*
+ * the renderer is done with sc and every scene before it, its damage and pooled releases
+ * are given back to the event thread pool
+ */
+static void scene_reclaim(scene *sc) {
+    if (sc->damage) {
+        region_put(&event_regions, sc->damage);
+        sc->damage = None;
+    }
+    for (int i = 0; i < sc->n_releases; i++)
+        if (sc->releases[i].type == RELEASE_POOLED_REGION)
+            region_put(&event_regions, sc->releases[i].id);
+    sc->n_releases = 0;
+}
+
+static void scene_build(scene *sc, XserverRegion region) {
+    scene_reclaim(sc);
+    if (!region)
+        region = full_screen_region();
+
+    sc->n_windows = 0;
+    for (win *w = s.managed_windows; w; w = w->next) {
+        // its pixmap was freed to fit the memory budget while it was hidden, it is read again once visible
+        if (w->evicted && !win_occluded(w)) {
+            w->evicted = False;
+            w->damaged = True;
+        }
+        /* never painted, ignore it */
+        if (!w->damaged)
+            continue;
+        /* if invisible, ignore it */
+        if (w->attr.x + w->attr.width < 1 || w->attr.y + w->attr.height < 1 || w->attr.x >= s.root_width || w->attr.y >= s.root_height)
+            continue;
+        if (!w->picture) {
+            XRenderPictureAttributes pa;
+            XRenderPictFormat *format;
+            Drawable draw = w->id;
+
+            if (!w->pixmap)
+                name_win_pixmap(w);
+            if (w->pixmap)
+                draw = w->pixmap;
+
+            format = XRenderFindVisualFormat(s.dpy, w->attr.visual);
+            pa.subwindow_mode = IncludeInferiors;
+            w->picture = XRenderCreatePicture(s.dpy, draw,
+                                              format,
+                                              CPSubwindowMode,
+                                              &pa);
+        }
+
+        if (s.clip_changed) {
+            if (w->border_size) {
+                scene_release_region(w->border_size);
+                w->border_size = None;
+            }
+            if (w->opaque_region) {
+                scene_recycle_region(w->opaque_region);
+                w->opaque_region = None;
+            }
+            if (w->extents) {
+                region_put(&event_regions, w->extents);
+                w->extents = None;
+            }
+        }
+        if (!w->border_size)
+            w->border_size = border_size(w);
+        if (!w->extents)
+            w->extents = win_extents(w);
+        if (w->n_opaque_rects && !w->opaque_region)
+            w->opaque_region = opaque_region(w);
+
+        if (sc->n_windows == sc->size_windows)
+            sc->windows = erealloc(sc->windows, (sc->size_windows += 32) * sizeof(scene_win));
+        scene_win *sw = &sc->windows[sc->n_windows++];
+        sw->id = w->id;
+        sw->border_size = w->border_size;
+        sw->morph = w->morph_picture != None;
+        if (sw->morph) {
+            sw->picture = w->morph_picture;
+            sw->geometry = w->morph_geometry;
+            sw->morph_width = w->morph_width;
+            sw->morph_height = w->morph_height;
+        } else {
+            sw->picture = w->picture;
+            sw->geometry.x = w->attr.x;
+            sw->geometry.y = w->attr.y;
+            sw->geometry.width = w->attr.width + w->attr.border_width * 2;
+            sw->geometry.height = w->attr.height + w->attr.border_width * 2;
+        }
+        sw->mode = w->mode;
+        sw->opacity = w->opacity;
+        sw->scale = w->scale;
+        sw->offset_x = w->offset_x;
+        sw->offset_y = w->offset_y;
+        // effects are applied while an action runs and once more after it ended, the renderer resets
+        // the transform the picture was left with by itself
+        sw->need_effect = w->action_running || w->need_effect;
+        w->need_effect = w->action_running;
+        sw->shadow = w->shadow;
+        sw->blur = w->blur_background && w->mode != WINDOW_SOLID;
+        sw->blur_dirty = sw->blur && (w->blur_dirty || s.clip_changed || s.root_tile_changed || sw->need_effect);
+        w->blur_dirty = False;
+        sw->corner_radius = w->corner_radius;
+        // the opaque region is not transformed with the window by effects
+        Bool transformed = sw->need_effect || sw->morph;
+        sw->opaque_region = w->mode == WINDOW_ARGB && w->opacity == 1.0 && !transformed ? w->opaque_region : None;
+        sw->dim = w->dim_inactive && w->id != s.active_window ? s.inactive_dim : 0.0;
+        sw->border_clip = None;
+    }
+
+    // a background is blurred from a fully repainted geometry, an animated window may have moved anywhere below it
+    Bool effect_below = False;
+    for (int i = sc->n_windows - 1; i >= 0; i--) {
+        scene_win *sw = &sc->windows[i];
+        if (sw->blur && (sw->blur_dirty || effect_below)) {
+            sw->blur_dirty = True;
+            XserverRegion r = region_get(&event_regions, &sw->geometry, 1);
+            XFixesUnionRegion(s.dpy, region, region, r);
+            region_put(&event_regions, r);
+        }
+        effect_below |= sw->need_effect;
+    }
+
+    sc->damage = region;
+    sc->root_width = s.root_width;
+    sc->root_height = s.root_height;
+    sc->root_tile_changed = s.root_tile_changed;
+    s.root_tile_changed = False;
+    s.clip_changed = False;
+    desktop_scene(&sc->desktop);
+
+    // hand the pending releases over to the scene, its previous (already freed) release array is reused
+    scene_release *releases = sc->releases;
+    int size_releases = sc->size_releases;
+    sc->releases = pending_releases;
+    sc->n_releases = n_pending_releases;
+    sc->size_releases = size_pending_releases;
+    pending_releases = releases;
+    n_pending_releases = 0;
+    size_pending_releases = size_releases;
+}
+
+static void scene_render(scene *sc) {
+    scene_free_releases(sc);
+    paint_all(sc);
+}
+
+static void *render_thread_main(void *data) {
+    uint64_t value;
+
+    for (;;) {
+        if (read(wake_fd, &value, sizeof(value)) < 0) {
+            if (errno == EINTR)
+                continue;
+            eprintf("render thread: cannot read wake up event\n");
+        }
+
+        unsigned int head = atomic_load_explicit(&queue_head, memory_order_relaxed);
+        unsigned int tail = atomic_load_explicit(&queue_tail, memory_order_acquire);
+        if (head == tail)
+            continue;
+
+        // only the latest scene is painted, the damage of the ones it replaces is merged into it
+        scene *last = &scenes[(tail - 1) & (SCENE_QUEUE_SIZE - 1)];
+        for (unsigned int i = head; i != tail - 1; i++) {
+            scene *sc = &scenes[i & (SCENE_QUEUE_SIZE - 1)];
+            scene_free_releases(sc);
+            for (int j = 0; j < sc->n_windows; j++)
+                if (sc->windows[j].blur_dirty)
+                    blur_invalidate(sc->windows[j].id);
+            XFixesUnionRegion(s.render_dpy, last->damage, last->damage, sc->damage);
+            last->root_tile_changed |= sc->root_tile_changed;
+            last->desktop.start |= sc->desktop.start;
+        }
+        scene_render(last);
+        XSync(s.render_dpy, False);
+
+        atomic_store_explicit(&queue_head, tail, memory_order_release);
+        value = 1;
+        if (write(s.ufds[UFD_FRAME].fd, &value, sizeof(value)) < 0)
+            eprintf("render thread: cannot signal frame\n");
+    }
+
+    return NULL;
+}
+
+void scene_init(void) {
+    if (!s.render_thread) {
+        s.render_dpy = s.dpy;
+        s.ufds[UFD_FRAME].fd = -1;
+        render_init();
+        return;
+    }
+
+    s.render_dpy = XOpenDisplay(DisplayString(s.dpy));
+    if (!s.render_dpy)
+        eprintf("render thread: cannot open display\n");
+
+    // extensions data is per connection
+    int event, error;
+    if (!XRenderQueryExtension(s.render_dpy, &event, &error) || !XFixesQueryExtension(s.render_dpy, &event, &error))
+        eprintf("render thread: missing extensions\n");
+    render_init();
+    XSync(s.render_dpy, False);
+
+    wake_fd = eventfd(0, EFD_CLOEXEC);
+    s.ufds[UFD_FRAME].fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    s.ufds[UFD_FRAME].events = POLLIN;
+    if (wake_fd < 0 || s.ufds[UFD_FRAME].fd < 0)
+        eprintf("render thread: cannot create eventfd\n");
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, render_thread_main, NULL) != 0)
+        eprintf("render thread: cannot create thread\n");
+    pthread_detach(thread);
+}
+
+Bool scene_ready(void) {
+    if (!s.render_thread)
+        return True;
+    unsigned int tail = atomic_load_explicit(&queue_tail, memory_order_relaxed);
+    return tail - atomic_load_explicit(&queue_head, memory_order_acquire) < SCENE_MAX_IN_FLIGHT;
+}
+
+void scene_paint(XserverRegion region) {
+    if (!output_frame_scheduled())
+        atomic_fetch_add_explicit(&stats.out_of_band_frames, 1, memory_order_relaxed);
+
+    // nothing is composited, the whole screen is damaged when compositing resumes
+    if (s.unredirected) {
+        if (region)
+            region_put(&event_regions, region);
+        return;
+    }
+
+    if (!s.render_thread) {
+        scene_build(&scenes[0], region);
+        scene_render(&scenes[0]);
+        XSync(s.dpy, False);
+        return;
+    }
+
+    if (!scene_ready()) {
+        // painted with the next scene
+        add_damage(region ? region : full_screen_region());
+        return;
+    }
+
+    unsigned int tail = atomic_load_explicit(&queue_tail, memory_order_relaxed);
+    scene_build(&scenes[tail & (SCENE_QUEUE_SIZE - 1)], region);
+    // the render connection must not see resources before the server created them
+    XSync(s.dpy, False);
+    atomic_store_explicit(&queue_tail, tail + 1, memory_order_release);
+
+    uint64_t value = 1;
+    if (write(wake_fd, &value, sizeof(value)) < 0)
+        eprintf("cannot wake up render thread\n");
+}
+
+void scene_frame_done(void) {
+    uint64_t value;
+    while (read(s.ufds[UFD_FRAME].fd, &value, sizeof(value)) > 0)
+        ;
+}
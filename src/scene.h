@@ -0,0 +1,96 @@
+#pragma once
+
+#include "desktop.h"
+#include "window.h"
+#include <X11/Xlib.h>
+#include <X11/extensions/Xfixes.h>
+#include <X11/extensions/Xrender.h>
+
+/*
+ * a scene is a snapshot of what the renderer needs to paint a frame
+ * it is built by the event thread from the managed windows and painted either directly
+ * or by the render thread on its own X connection
+ */
+
+typedef struct _scene_win {
+    Window id;
+    Picture picture;
+    XserverRegion border_size;
+    XserverRegion opaque_region; // part of an ARGB window painted like a solid window, None if there is none
+    XRectangle geometry; // includes borders
+    int mode;
+    double opacity;
+    double scale;
+    int offset_x;
+    int offset_y;
+    Bool need_effect;
+    Bool shadow;
+    Bool blur; // paint a blurred copy of what is below the window behind it
+    Bool blur_dirty; // the blurred background must be recomputed, the window geometry is then part of the damage
+    int corner_radius;
+    double dim; // opacity of the black painted over the window, 0 when it is not dimmed
+    Bool morph; // picture holds the contents from before a move or resize, stretched from their size to geometry
+    int morph_width, morph_height;
+
+    /* renderer scratch data, what is left of the damage above the window, shared with the windows next to it */
+    XserverRegion border_clip;
+} scene_win;
+
+typedef enum _release_type {
+    RELEASE_PICTURE,
+    RELEASE_REGION,
+    RELEASE_POOLED_REGION // given back to the event thread region pool instead of being destroyed
+} release_type;
+
+// server resources the event thread stopped using but a scene being painted may still reference
+typedef struct _scene_release {
+    release_type type;
+    XID id;
+} scene_release;
+
+typedef struct _scene {
+    scene_win *windows; // top to bottom
+    int n_windows, size_windows;
+    XserverRegion damage; // given back to the event thread region pool when the scene is built again
+    int root_width, root_height;
+    Bool root_tile_changed;
+    desktop_transition desktop; // windows are painted into the incoming snapshot while it runs
+    scene_release *releases; // freed by the renderer before painting this scene
+    int n_releases, size_releases;
+} scene;
+
+/*
+ * starts the render thread if it is enabled
+ */
+void scene_init(void);
+
+/*
+ * returns True if a new scene can be painted without waiting for the render thread
+ */
+Bool scene_ready(void);
+
+/*
+ * builds a scene from the managed windows and paints region (None means the whole screen)
+ * region must come from the event thread pool and is owned by the scene, if the render thread is busy
+ * region is added to the damage instead
+ * only the frame scheduler paints scenes, from the damage output_take_damage() returned, scenes painted
+ * otherwise are counted as out of band frames
+ */
+void scene_paint(XserverRegion region);
+
+/*
+ * called by the event loop when the render thread signaled a finished frame
+ */
+void scene_frame_done(void);
+
+/*
+ * free a resource once no scene in flight references it
+ */
+void scene_release_picture(Picture picture);
+
+void scene_release_region(XserverRegion region);
+
+/*
+ * give a region taken from the event thread pool back to it once no scene in flight references it
+ */
+void scene_recycle_region(XserverRegion region);
@@ -1,20 +1,37 @@
 #include "session.h"
 #include "action.h"
 #include "config.h"
+#include "desktop.h"
 #include "effect.h"
+#include "ipc.h"
+#include "memory.h"
+#include "morph.h"
+#include "output.h"
+#include "pool.h"
+#include "present.h"
+#include "record.h"
 #include "render.h"
+#include "scene.h"
+#include "stats.h"
+#include "thumbnail.h"
 #include "util.h"
 #include "window.h"
 #include <X11/Xatom.h>
 #include <X11/Xlib.h>
 #include <X11/extensions/Xcomposite.h>
+#include <X11/extensions/Xrandr.h>
 #include <X11/extensions/Xrender.h>
 #include <X11/extensions/shape.h>
+#include <errno.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 
 struct session s;
 
+static volatile sig_atomic_t quit = 0;
+static volatile sig_atomic_t reset_stats = 0;
+
 static XRectangle *expose_rects = NULL;
 static int size_expose = 0;
 static int n_expose = 0;
@@ -60,7 +77,7 @@ static void handle_event(XEvent ev) {
             COPY_AREA(&expose_rects[n_expose], &ev.xexpose);
             n_expose++;
             if (ev.xexpose.count == 0) {
-                add_damage(XFixesCreateRegion(s.dpy, expose_rects, n_expose));
+                add_damage(region_get(&event_regions, expose_rects, n_expose));
                 n_expose = 0;
             }
         }
@@ -71,18 +88,33 @@ static void handle_event(XEvent ev) {
             // reset mode and redraw window
             win *w = find_win(ev.xproperty.window, True);
             if (w) {
-                w->opacity = get_opacity_prop(w, 1.0);
+                w->opacity = get_opacity_prop(w, default_opacity(w));
                 determine_mode(w);
             }
         } else if (ev.xproperty.atom == s.winstate_atoms[NUM_WINSTATES]) {
             win *w = find_win(ev.xproperty.window, True);
             if (w)
                 determine_winstate(w);
-        } else if (s.root_tile && (ev.xproperty.atom == s.background_atoms[0] ||
-                                   ev.xproperty.atom == s.background_atoms[1])) {
+        } else if (ev.xproperty.atom == s.background_atoms[0] || ev.xproperty.atom == s.background_atoms[1]) {
             XClearArea(s.dpy, s.root, 0, 0, 0, 0, True);
-            XRenderFreePicture(s.dpy, s.root_tile);
-            s.root_tile = None;
+            s.root_tile_changed = True;
+        } else if (ev.xproperty.atom == s.active_atom && ev.xproperty.window == s.root) {
+            determine_active_win();
+        } else if (ev.xproperty.atom == s.current_desktop_atom && ev.xproperty.window == s.root) {
+            desktop_changed();
+        } else if (ev.xproperty.atom == s.wm_desktop_atom) {
+            win *w = find_win(ev.xproperty.window, True);
+            if (w)
+                determine_desktop(w);
+        } else if (ev.xproperty.atom == s.opaque_region_atom) {
+            win *w = find_win(ev.xproperty.window, True);
+            if (w)
+                determine_opaque_region(w);
+        } else if (ev.xproperty.atom == XA_WM_CLASS || ev.xproperty.atom == XA_WM_NAME ||
+                   ev.xproperty.atom == s.net_wm_name_atom || ev.xproperty.atom == s.role_atom) {
+            win *w = find_win(ev.xproperty.window, True);
+            if (w && w->window_type != WINTYPE_UNKNOWN && determine_rule(w, ev.xproperty.atom))
+                refresh_effect_rules(w);
         }
         break;
     default:
@@ -90,31 +122,174 @@ static void handle_event(XEvent ev) {
             damage_win((XDamageNotifyEvent *) &ev);
         } else if (ev.type == s.xshape_event + ShapeNotify) {
             shape_win((XShapeEvent *) &ev);
+        } else if (ev.type == GenericEvent && s.render_dpy == s.dpy) {
+            present_handle_event(&ev);
+        } else if (s.has_randr && ev.type == s.randr_event + RRScreenChangeNotify) {
+            XRRScreenChangeNotifyEvent *sce = (XRRScreenChangeNotifyEvent *) &ev;
+            XRRUpdateConfiguration(&ev);
+            // the outputs and the damage are made for the new size, the size of the event is unrotated
+            Bool rotated = sce->rotation & (RR_Rotate_90 | RR_Rotate_270);
+            s.root_width = rotated ? sce->height : sce->width;
+            s.root_height = rotated ? sce->width : sce->height;
+            output_update();
+            XRectangle r = {0, 0, s.root_width, s.root_height};
+            add_damage(region_get(&event_regions, &r, 1));
         }
         break;
     }
+
+    record_event(&ev);
+}
+
+/*
+ * returns the earliest of two poll timeouts, -1 meaning no timeout
+ */
+static int earliest_timeout(int a, int b) {
+    if (a < 0)
+        return b;
+    if (b < 0)
+        return a;
+    return a < b ? a : b;
+}
+
+/*
+ * returns the window drawn by the server instead of being composited, the topmost one if its rule allows it
+ * and it covers the whole screen
+ */
+static win *unredirect_window(void) {
+    for (win *w = s.managed_windows; w; w = w->next) {
+        if (w->attr.map_state != IsViewable)
+            continue;
+        if (w->unredirect && w->mode == WINDOW_SOLID && !w->action_running && !w->morph_picture &&
+            w->attr.x <= 0 && w->attr.y <= 0 &&
+            w->attr.x + w->attr.width + w->attr.border_width * 2 >= s.root_width &&
+            w->attr.y + w->attr.height + w->attr.border_width * 2 >= s.root_height)
+            return w;
+        return NULL;
+    }
+    return NULL;
+}
+
+static void update_redirection(void) {
+    Bool unredirect = unredirect_window() != NULL;
+    if (unredirect == s.unredirected)
+        return;
+    s.unredirected = unredirect;
+
+    if (unredirect) {
+        // named pixmaps would keep the contents windows had when they stopped being redirected
+        for (win *w = s.managed_windows; w; w = w->next)
+            free_win_pixmap(w);
+        present_show_overlay(False);
+        XCompositeUnredirectSubwindows(s.dpy, s.root, CompositeRedirectManual);
+    } else {
+        XCompositeRedirectSubwindows(s.dpy, s.root, CompositeRedirectManual);
+        present_show_overlay(True);
+        s.clip_changed = True;
+        XRectangle r = {0, 0, s.root_width, s.root_height};
+        add_damage(region_get(&event_regions, &r, 1));
+    }
+}
+
+/*
+ * applies the effect-rules of every window again, what they look like may have changed anywhere
+ */
+static void refresh_windows(void) {
+    for (win *w = s.managed_windows; w; w = w->next) {
+        if (w->window_type != WINTYPE_UNKNOWN)
+            refresh_effect_rules(w);
+    }
+    s.clip_changed = True;
+    XRectangle r = {0, 0, s.root_width, s.root_height};
+    add_damage(region_get(&event_regions, &r, 1));
+}
+
+Bool session_reload_config(void) {
+    if (!config_reload())
+        return False;
+
+    // the rules of the previous config are freed
+    for (win *w = s.managed_windows; w; w = w->next) {
+        w->rule = NULL;
+        if (w->window_type != WINTYPE_UNKNOWN)
+            determine_rule(w, None);
+    }
+    refresh_windows();
+    return True;
+}
+
+void session_pause_effects(Bool paused) {
+    if (paused == s.effects_paused)
+        return;
+    s.effects_paused = paused;
+    refresh_windows();
+}
+
+static void reload_config(void) {
+    if (config_changed())
+        session_reload_config();
+}
+
+static void handle_quit(int sig) {
+    quit = 1;
+}
+
+static void handle_reset_stats(int sig) {
+    reset_stats = 1;
 }
 
 void session_loop(void) {
-    for (;;) {
+    while (!quit) {
+        if (reset_stats) {
+            stats_init();
+            reset_stats = 0;
+        }
         do {
             // if no event in queue we run animations
             if (!QLength(s.dpy)) {
-                if (poll(&s.ufd, 1, action_timeout()) == 0) {
+                // due damage waits for the render thread, which wakes the loop through UFD_FRAME once it is done
+                int timeout = earliest_timeout(action_timeout(), scene_ready() ? output_timeout() : -1);
+                timeout = earliest_timeout(timeout, thumbnail_timeout());
+                timeout = earliest_timeout(timeout, desktop_timeout());
+                timeout = earliest_timeout(timeout, morph_timeout());
+                int ret = poll(s.ufds, NUM_UFDS, timeout);
+                if (ret == 0) {
                     action_run();
                     break;
                 }
+                if (ret < 0 && errno == EINTR)
+                    break;
+                if (s.ufds[UFD_FRAME].revents & POLLIN)
+                    scene_frame_done();
+                if (s.ufds[UFD_CONFIG].revents & POLLIN)
+                    reload_config();
+                ipc_dispatch();
+                if (!(s.ufds[UFD_X].revents & POLLIN))
+                    break;
             }
 
             XEvent ev;
             XNextEvent(s.dpy, &ev);
             handle_event(ev);
         } while (QLength(s.dpy));
+        thumbnail_run();
+        desktop_run();
+        morph_run();
+        memory_enforce();
+        update_redirection();
         if (s.all_damage) {
-            paint_all(s.all_damage);
-            XSync(s.dpy, False);
+            // the whole screen is damaged when compositing resumes
+            if (s.unredirected)
+                region_put(&event_regions, s.all_damage);
+            else
+                output_add_damage(s.all_damage);
             s.all_damage = None;
-            s.clip_changed = False;
+        }
+        // while the render thread is busy or an output waits for its next refresh, damage keeps accumulating
+        if (scene_ready() && !s.unredirected) {
+            XserverRegion region = output_take_damage();
+            if (region)
+                scene_paint(region);
         }
     }
 }
@@ -148,21 +323,32 @@ static void register_composite_manager(void) {
     XSetSelectionOwner(s.dpy, a, w, 0);
 }
 
-void session_init(const char *display, const char *config_path) {
+void session_init(const char *display, const char *config_path, const char *ipc_path) {
     Window root_return, parent_return;
     Window *children;
     unsigned int nchildren;
-    XRenderPictureAttributes pa;
     int composite_major, composite_minor;
 
+    // the config decides if a render thread is used, which must be known before any other Xlib call
+    if (!config_get(config_path))
+        exit(EXIT_FAILURE);
+    if (s.render_thread && !XInitThreads())
+        eprintf("cannot initialize Xlib threads\n");
+
     s.dpy = XOpenDisplay(display);
     if (!s.dpy)
         eprintf("cannot open display\n");
     XSetErrorHandler(handle_error);
+    signal(SIGINT, handle_quit);
+    signal(SIGTERM, handle_quit);
+    signal(SIGUSR1, handle_reset_stats);
     s.screen = DefaultScreen(s.dpy);
     s.root = RootWindow(s.dpy, s.screen);
-    s.ufd.fd = XConnectionNumber(s.dpy);
-    s.ufd.events = POLLIN;
+    s.ufds[UFD_X].fd = XConnectionNumber(s.dpy);
+    s.ufds[UFD_X].events = POLLIN;
+    s.ufds[UFD_CONFIG].fd = config_watch();
+    s.ufds[UFD_CONFIG].events = POLLIN;
+    ipc_init(ipc_path);
 
     if (!XRenderQueryExtension(s.dpy, &s.render_event, &s.render_error))
         eprintf("No render extension\n");
@@ -184,6 +370,12 @@ void session_init(const char *display, const char *config_path) {
 
     // get atoms
     s.opacity_atom = XInternAtom(s.dpy, "_NET_WM_WINDOW_OPACITY", False);
+    s.active_atom = XInternAtom(s.dpy, "_NET_ACTIVE_WINDOW", False);
+    s.opaque_region_atom = XInternAtom(s.dpy, "_NET_WM_OPAQUE_REGION", False);
+    s.net_wm_name_atom = XInternAtom(s.dpy, "_NET_WM_NAME", False);
+    s.role_atom = XInternAtom(s.dpy, "WM_WINDOW_ROLE", False);
+    s.current_desktop_atom = XInternAtom(s.dpy, "_NET_CURRENT_DESKTOP", False);
+    s.wm_desktop_atom = XInternAtom(s.dpy, "_NET_WM_DESKTOP", False);
     s.background_atoms[0] = XInternAtom(s.dpy, "_XROOTPMAP_ID", False);
     s.background_atoms[1] = XInternAtom(s.dpy, "_XSETROOT_ID", False);
     s.winstate_atoms[WINSTATE_MAXIMIZED_VERT] = XInternAtom(s.dpy, "_NET_WM_STATE_MAXIMIZED_VERT", False);
@@ -206,19 +398,15 @@ void session_init(const char *display, const char *config_path) {
     s.wintype_atoms[WINTYPE_NORMAL] = XInternAtom(s.dpy, "_NET_WM_WINDOW_TYPE_NORMAL", False);
     s.wintype_atoms[NUM_WINTYPES] = XInternAtom(s.dpy, "_NET_WM_WINDOW_TYPE", False);
 
-    config_get(config_path);
-
-    pa.subwindow_mode = IncludeInferiors;
     s.root_width = DisplayWidth(s.dpy, s.screen);
     s.root_height = DisplayHeight(s.dpy, s.screen);
+    output_init();
+
+    scene_init();
 
-    s.root_picture = XRenderCreatePicture(s.dpy, s.root,
-                                          XRenderFindVisualFormat(s.dpy,
-                                                                  DefaultVisual(s.dpy, s.screen)),
-                                          CPSubwindowMode,
-                                          &pa);
     s.all_damage = None;
     s.clip_changed = True;
+    s.unredirected = False;
     XGrabServer(s.dpy);
     XCompositeRedirectSubwindows(s.dpy, s.root, CompositeRedirectManual);
     XSelectInput(s.dpy, s.root,
@@ -227,11 +415,16 @@ void session_init(const char *display, const char *config_path) {
                      StructureNotifyMask |
                      PropertyChangeMask);
     XShapeSelectInput(s.dpy, s.root, ShapeNotifyMask);
+    desktop_init();
     XQueryTree(s.dpy, s.root, &root_return, &parent_return, &children, &nchildren);
     for (int i = 0; i < nchildren; i++)
         add_win(children[i]);
     XFree(children);
+    determine_active_win();
     XUngrabServer(s.dpy);
 
-    paint_all(None);
+    stats_init();
+    // the first frame is scheduled like the others
+    XRectangle r = {0, 0, s.root_width, s.root_height};
+    output_add_damage(region_get(&event_regions, &r, 1));
 }
@@ -1,32 +1,81 @@
 #pragma once
 
+#include "output.h"
 #include "window.h"
 #include <X11/Xlib.h>
 #include <X11/extensions/Xdamage.h>
 #include <X11/extensions/Xrender.h>
 #include <poll.h>
 
+#define IPC_MAX_CLIENTS 4 // control socket clients connected at the same time
+
+// file descriptors polled by the event loop
+enum {
+    UFD_X,           // X connection
+    UFD_FRAME,       // render thread finished a frame
+    UFD_CONFIG,      // config file changed
+    UFD_IPC,         // control socket accepting clients
+    UFD_IPC_CLIENTS, // first of the IPC_MAX_CLIENTS control socket clients, -1 if the slot is free
+    NUM_UFDS = UFD_IPC_CLIENTS + IPC_MAX_CLIENTS
+};
+
 struct session {
     Display *dpy;
-    struct pollfd ufd;
+    Display *render_dpy; // connection used to paint, same as dpy if render_thread is False
+    Bool render_thread;
+    Bool present; // frames are presented on the overlay window through back buffers instead of copied to the root
+    Bool capture; // frames are exported to capture clients through shared memory
+    unsigned long int retain_budget; // bytes of unmapped window contents kept for their next map
+    unsigned long int memory_budget; // bytes of server memory pixmaps may hold, 0 for no limit
+    struct pollfd ufds[NUM_UFDS];
     win *managed_windows;
     int screen;
     Window root;
     Picture root_picture;
     Picture root_buffer;
     Picture root_tile;
+    Bool root_tile_changed;
     XserverRegion all_damage;
     Bool clip_changed;
+    Bool unredirected; // compositing is suspended while a fullscreen window with an unredirect rule is on top
+    Bool effects_paused; // animations, shadows and background blur are turned off through the control socket
     int root_height, root_width;
+    output *outputs;
+    int n_outputs;
     int xfixes_event, xfixes_error;
     int damage_event, damage_error;
     int composite_event, composite_error;
     int render_event, render_error;
     int xshape_event, xshape_error;
+    Bool has_randr;
+    int randr_event, randr_error;
     int composite_opcode;
-    int effect_delta;
+    int effect_delta; // 0 to derive the tick from the refresh rate
+    double effect_tick; // milliseconds between two effect steps
+
+    int shadow_radius;
+    double shadow_opacity;
+    int shadow_offset_x;
+    int shadow_offset_y;
+    Bool wintype_shadows[NUM_WINTYPES];
+
+    int blur_strength;
+    Bool wintype_blurs[NUM_WINTYPES];
+
+    int wintype_corner_radius[NUM_WINTYPES];
+
+    double inactive_dim;
+    Bool wintype_dims[NUM_WINTYPES];
+    Window active_window; // managed window holding the focus
+    long current_desktop; // _NET_CURRENT_DESKTOP, -1 if the window manager does not set it
 
     Atom opacity_atom;
+    Atom active_atom;
+    Atom opaque_region_atom;
+    Atom net_wm_name_atom;
+    Atom role_atom;
+    Atom current_desktop_atom;
+    Atom wm_desktop_atom;
     Atom background_atoms[2];
     Atom winstate_atoms[6];
     Atom wintype_atoms[15];
@@ -34,6 +83,20 @@ struct session {
 
 extern struct session s;
 
+/*
+ * runs the event loop until SIGINT or SIGTERM is received
+ * SIGUSR1 resets frame statistics
+ */
 void session_loop(void);
 
-void session_init(const char *display, const char *config_path);
+void session_init(const char *display, const char *config_path, const char *ipc_path);
+
+/*
+ * reloads the config file and matches every window against its rules, returns False if it is invalid
+ */
+Bool session_reload_config(void);
+
+/*
+ * turns animations, shadows and background blur off or back on for every window
+ */
+void session_pause_effects(Bool paused);
@@ -0,0 +1,140 @@
+#include "shadow.h"
+#include "memory.h"
+#include "session.h"
+#include "util.h"
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/Xrender.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#define SHADOW_CACHE_SIZE 64
+
+typedef struct _shadow_entry {
+    int width, height;
+    Picture picture;
+    unsigned long int bytes;
+    unsigned long int last_used;
+} shadow_entry;
+
+// cumulative sums of the normalized gaussian kernel, kernel_sums[i] is the sum of the first i values
+static double *kernel_sums = NULL;
+static int kernel_size = 0;
+
+static shadow_entry cache[SHADOW_CACHE_SIZE];
+static unsigned long int cache_clock = 0;
+
+// pictures evicted while the frame may still use them, freed once it is submitted
+static Picture *evicted = NULL;
+static int n_evicted = 0, size_evicted = 0;
+static unsigned long int evicted_bytes = 0;
+
+void shadow_init(void) {
+    int r = s.shadow_radius;
+    double sigma = r > 0 ? r / 2.0 : 1.0;
+
+    kernel_size = 2 * r + 1;
+    free(kernel_sums);
+    kernel_sums = ecalloc(kernel_size + 1, sizeof(double));
+
+    double total = 0;
+    for (int i = 0; i < kernel_size; i++) {
+        double x = i - r;
+        total += exp(-(x * x) / (2 * sigma * sigma));
+        kernel_sums[i + 1] = total;
+    }
+    for (int i = 0; i <= kernel_size; i++)
+        kernel_sums[i] /= total;
+}
+
+/*
+ * a window blurred by a separable kernel is the product of its blurred horizontal and vertical
+ * profiles, profile[i] is the coverage of a length pixels segment convolved with the kernel
+ */
+static void shadow_profile(double *profile, int length) {
+    int size = length + kernel_size - 1;
+    for (int i = 0; i < size; i++) {
+        int lo = i - length + 1 > 0 ? i - length + 1 : 0;
+        int hi = i < kernel_size - 1 ? i : kernel_size - 1;
+        profile[i] = kernel_sums[hi + 1] - kernel_sums[lo];
+    }
+}
+
+static Picture shadow_build(int width, int height) {
+    int sw = width + kernel_size - 1;
+    int sh = height + kernel_size - 1;
+    double *px = ecalloc(sw + sh, sizeof(double));
+    double *py = px + sw;
+    // rows are padded to 32 bits for XPutImage
+    int stride = (sw + 3) & ~3;
+    uint8_t *data = ecalloc(stride, sh);
+
+    shadow_profile(px, width);
+    shadow_profile(py, height);
+    for (int x = 0; x < sw; x++)
+        px[x] *= s.shadow_opacity * 0xff;
+    for (int y = 0; y < sh; y++) {
+        uint8_t *row = data + y * stride;
+        double v = py[y];
+        for (int x = 0; x < sw; x++)
+            row[x] = px[x] * v;
+    }
+    free(px);
+
+    XImage *image = XCreateImage(s.render_dpy, DefaultVisual(s.render_dpy, s.screen), 8, ZPixmap, 0,
+                                 (char *) data, sw, sh, 32, stride);
+    if (!image) {
+        free(data);
+        return None;
+    }
+
+    Pixmap pixmap = XCreatePixmap(s.render_dpy, s.root, sw, sh, 8);
+    GC gc = XCreateGC(s.render_dpy, pixmap, 0, NULL);
+    XPutImage(s.render_dpy, pixmap, gc, image, 0, 0, 0, 0, sw, sh);
+    XFreeGC(s.render_dpy, gc);
+    XDestroyImage(image); // frees data
+
+    Picture picture = XRenderCreatePicture(s.render_dpy, pixmap,
+                                           XRenderFindStandardFormat(s.render_dpy, PictStandardA8),
+                                           0, NULL);
+    XFreePixmap(s.render_dpy, pixmap);
+    return picture;
+}
+
+Picture shadow_picture(int width, int height) {
+    shadow_entry *lru = &cache[0];
+
+    cache_clock++;
+    for (int i = 0; i < SHADOW_CACHE_SIZE; i++) {
+        shadow_entry *e = &cache[i];
+        if (e->picture && e->width == width && e->height == height) {
+            e->last_used = cache_clock;
+            return e->picture;
+        }
+        if (e->last_used < lru->last_used)
+            lru = e;
+    }
+
+    if (lru->picture) {
+        if (n_evicted == size_evicted)
+            evicted = erealloc(evicted, (size_evicted += 16) * sizeof(Picture));
+        evicted[n_evicted++] = lru->picture;
+        evicted_bytes += lru->bytes;
+    }
+    lru->width = width;
+    lru->height = height;
+    lru->picture = shadow_build(width, height);
+    lru->bytes = lru->picture ? memory_pixmap_bytes(width + kernel_size - 1, height + kernel_size - 1, 8) : 0;
+    memory_add(MEMORY_MASKS, lru->bytes);
+    lru->last_used = cache_clock;
+    return lru->picture;
+}
+
+void shadow_frame_end(void) {
+    for (int i = 0; i < n_evicted; i++)
+        XRenderFreePicture(s.render_dpy, evicted[i]);
+    n_evicted = 0;
+    memory_add(MEMORY_MASKS, -(long int) evicted_bytes);
+    evicted_bytes = 0;
+}
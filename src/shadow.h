@@ -0,0 +1,22 @@
+#pragma once
+
+#include <X11/Xlib.h>
+#include <X11/extensions/Xrender.h>
+
+/*
+ * computes the gaussian kernel from the shadow config (s.shadow_radius)
+ */
+void shadow_init(void);
+
+/*
+ * returns the A8 shadow picture of a width x height window, the picture covers
+ * (width + 2 * s.shadow_radius) x (height + 2 * s.shadow_radius) pixels
+ * pictures are cached by size and owned by the cache, render thread only
+ * a picture stays valid until the end of the frame it was returned for
+ */
+Picture shadow_picture(int width, int height);
+
+/*
+ * frees the pictures evicted from the cache during the frame, once its commands are submitted
+ */
+void shadow_frame_end(void);
@@ -0,0 +1,77 @@
+#include "stats.h"
+#include "memory.h"
+#include "pool.h"
+#include "retain.h"
+#include "session.h"
+#include "util.h"
+#include <X11/Xlib.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+
+struct stats stats;
+
+static unsigned long int frame_start_request;
+
+static double get_time(void) {
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+void stats_init(void) {
+    atomic_store(&stats.frames, 0);
+    atomic_store(&stats.out_of_band_frames, 0);
+    atomic_store(&stats.frame_requests, 0);
+    atomic_store(&stats.commands, 0);
+    atomic_store(&stats.dropped_commands, 0);
+    stats.start_request = NextRequest(s.dpy);
+    stats.start_time = get_time();
+}
+
+void stats_frame_start(void) {
+    frame_start_request = NextRequest(s.render_dpy);
+}
+
+void stats_frame_end(void) {
+    atomic_fetch_add_explicit(&stats.frames, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&stats.frame_requests, NextRequest(s.render_dpy) - frame_start_request,
+                              memory_order_relaxed);
+}
+
+void stats_print(FILE *f) {
+    struct rusage usage;
+    double elapsed = get_time() - stats.start_time;
+    unsigned long int n_frames = atomic_load(&stats.frames);
+    unsigned long int frame_requests = atomic_load(&stats.frame_requests);
+    unsigned long int requests = NextRequest(s.dpy) - stats.start_request;
+    // frames painted by the render thread use their own connection
+    if (s.render_dpy != s.dpy)
+        requests += frame_requests;
+    double frames = n_frames ? n_frames : 1;
+
+    getrusage(RUSAGE_SELF, &usage);
+    double user = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6;
+    double sys = usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+
+    fprintf(f, "frames: %lu\n", n_frames);
+    fprintf(f, "out of band frames: %lu\n", (unsigned long int) stats.out_of_band_frames);
+    fprintf(f, "elapsed: %.3f s\n", elapsed);
+    fprintf(f, "fps: %.2f\n", elapsed > 0 ? n_frames / elapsed : 0.0);
+    fprintf(f, "cpu user: %.3f s\n", user);
+    fprintf(f, "cpu sys: %.3f s\n", sys);
+    fprintf(f, "cpu per frame: %.3f ms\n", (user + sys) * 1000.0 / frames);
+    fprintf(f, "requests: %lu\n", requests);
+    fprintf(f, "requests per frame: %.2f\n", requests / frames);
+    fprintf(f, "paint requests per frame: %.2f\n", frame_requests / frames);
+    fprintf(f, "render commands per frame: %.2f (%.2f dropped)\n", atomic_load(&stats.commands) / frames,
+            atomic_load(&stats.dropped_commands) / frames);
+    fprintf(f, "region pool: %lu hits, %lu misses\n", (unsigned long int) pool_counters.region_hits,
+            (unsigned long int) pool_counters.region_misses);
+    fprintf(f, "picture pool: %lu hits, %lu misses\n", (unsigned long int) pool_counters.picture_hits,
+            (unsigned long int) pool_counters.picture_misses);
+    fprintf(f, "retained windows: %d (%.1f MiB)\n", retain_count(), retain_bytes() / (1024.0 * 1024.0));
+    memory_print(f);
+    fprintf(f, "errors ignored: %lu\n", (unsigned long int) error_counters.ignored);
+    fprintf(f, "errors reported: %lu\n", (unsigned long int) error_counters.reported);
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdio.h>
+
+// the counters are updated by both the event and the render thread
+struct stats {
+    atomic_ulong frames;
+    atomic_ulong out_of_band_frames; // scenes painted without being scheduled by an output, should stay 0
+    atomic_ulong frame_requests;     // requests issued while painting frames
+    atomic_ulong commands;           // render commands submitted
+    atomic_ulong dropped_commands;   // render commands outside of the damage, dropped before submission
+    unsigned long int start_request;  // first request sequence after init
+    double start_time;                // wall clock time in seconds at init
+};
+
+extern struct stats stats;
+
+void stats_init(void);
+
+void stats_frame_start(void);
+
+void stats_frame_end(void);
+
+void stats_print(FILE *f);
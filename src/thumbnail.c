@@ -0,0 +1,162 @@
+#include "thumbnail.h"
+#include "memory.h"
+#include "session.h"
+#include "util.h"
+#include <X11/Xlib.h>
+#include <X11/extensions/Xrender.h>
+#include <stdlib.h>
+
+typedef struct _thumbnail {
+    struct _thumbnail *next;
+    win *w;
+    Pixmap pixmap;
+    Picture picture;
+    XRectangle content; // part of the pixmap covered by the window
+    Bool dirty;
+    double painted; // time of the last repaint
+    double asked;   // time it was last asked for
+} thumbnail;
+
+static thumbnail *thumbnails = NULL;
+
+static thumbnail *thumbnail_find(win *w) {
+    for (thumbnail *t = thumbnails; t; t = t->next) {
+        if (t->w == w)
+            return t;
+    }
+    return NULL;
+}
+
+static void thumbnail_free(thumbnail *t) {
+    for (thumbnail **prev = &thumbnails; *prev; prev = &(*prev)->next) {
+        if (*prev == t) {
+            *prev = t->next;
+            XRenderFreePicture(s.dpy, t->picture);
+            XFreePixmap(s.dpy, t->pixmap);
+            memory_add(MEMORY_THUMBNAILS, -(long int) memory_pixmap_bytes(THUMBNAIL_SIZE, THUMBNAIL_SIZE, 32));
+            free(t);
+            break;
+        }
+    }
+}
+
+/*
+ * scales the window pixmap into the thumbnail, returns False if the window has no contents to read
+ */
+static Bool thumbnail_paint(thumbnail *t) {
+    win *w = t->w;
+
+    // only windows painted at least once have contents, the server draws unredirected ones itself
+    if (w->attr.map_state != IsViewable || !w->damaged || s.unredirected)
+        return False;
+    if (!w->pixmap && !name_win_pixmap(w))
+        return False;
+
+    int width = w->attr.width + w->attr.border_width * 2;
+    int height = w->attr.height + w->attr.border_width * 2;
+    double scale = (double) THUMBNAIL_SIZE / (width > height ? width : height);
+    if (scale > 1.0)
+        scale = 1.0;
+    XRectangle content = {.width = width * scale, .height = height * scale};
+    content.x = (THUMBNAIL_SIZE - content.width) / 2;
+    content.y = (THUMBNAIL_SIZE - content.height) / 2;
+
+    // the margins are transparent, they only change with the aspect ratio of the window
+    if (content.width != t->content.width || content.height != t->content.height) {
+        XRenderColor clear = {0};
+        XRenderFillRectangle(s.dpy, PictOpSrc, t->picture, &clear, 0, 0, THUMBNAIL_SIZE, THUMBNAIL_SIZE);
+        t->content = content;
+    }
+
+    // a picture of its own, the window picture transform belongs to the renderer
+    Picture source = XRenderCreatePicture(s.dpy, w->pixmap, XRenderFindVisualFormat(s.dpy, w->attr.visual), 0, NULL);
+    XTransform transform = {{{XDoubleToFixed(1.0 / scale), 0, 0},
+                             {0, XDoubleToFixed(1.0 / scale), 0},
+                             {0, 0, XDoubleToFixed(1.0)}}};
+    XRenderSetPictureTransform(s.dpy, source, &transform);
+    XRenderSetPictureFilter(s.dpy, source, FilterBilinear, NULL, 0);
+    XRenderComposite(s.dpy, PictOpSrc, source, None, t->picture, 0, 0, 0, 0,
+                     content.x, content.y, content.width, content.height);
+    XRenderFreePicture(s.dpy, source);
+    return True;
+}
+
+Pixmap thumbnail_get(win *w, XRectangle *content) {
+    if (w->attr.class == InputOnly)
+        return None;
+
+    double now = get_time_in_milliseconds();
+    thumbnail *t = thumbnail_find(w);
+    if (!t) {
+        t = ecalloc(1, sizeof(thumbnail));
+        t->w = w;
+        t->pixmap = XCreatePixmap(s.dpy, s.root, THUMBNAIL_SIZE, THUMBNAIL_SIZE, 32);
+        memory_add(MEMORY_THUMBNAILS, memory_pixmap_bytes(THUMBNAIL_SIZE, THUMBNAIL_SIZE, 32));
+        t->picture = XRenderCreatePicture(s.dpy, t->pixmap, XRenderFindStandardFormat(s.dpy, PictStandardARGB32),
+                                          0, NULL);
+        t->dirty = True;
+        t->next = thumbnails;
+        thumbnails = t;
+    }
+    t->asked = now;
+    // a new thumbnail is painted right away, its first contents should not wait for the next repaint
+    if (t->dirty && !t->painted) {
+        if (thumbnail_paint(t))
+            t->painted = now;
+        t->dirty = False;
+    }
+    *content = t->content;
+    return t->pixmap;
+}
+
+void thumbnail_damage(win *w) {
+    thumbnail *t = thumbnail_find(w);
+    if (t)
+        t->dirty = True;
+}
+
+void thumbnail_cleanup(win *w) {
+    thumbnail *t = thumbnail_find(w);
+    if (t)
+        thumbnail_free(t);
+}
+
+int thumbnail_timeout(void) {
+    if (!thumbnails)
+        return -1;
+
+    double now = get_time_in_milliseconds();
+    double next = -1;
+    for (thumbnail *t = thumbnails; t; t = t->next) {
+        double due = t->asked + THUMBNAIL_TTL;
+        if (t->dirty && t->painted + THUMBNAIL_INTERVAL < due)
+            due = t->painted + THUMBNAIL_INTERVAL;
+        if (next < 0 || due < next)
+            next = due;
+    }
+    return next > now ? (int) (next - now) + 1 : 0;
+}
+
+void thumbnail_run(void) {
+    if (!thumbnails)
+        return;
+
+    double now = get_time_in_milliseconds();
+    Bool painted = False;
+    for (thumbnail *t = thumbnails, *next; t; t = next) {
+        next = t->next;
+        if (now >= t->asked + THUMBNAIL_TTL) {
+            thumbnail_free(t);
+        } else if (t->dirty && now >= t->painted + THUMBNAIL_INTERVAL) {
+            // a window that cannot be read now is painted after its next damage
+            if (thumbnail_paint(t)) {
+                t->painted = now;
+                painted = True;
+            }
+            t->dirty = False;
+        }
+    }
+    // nothing else may flush the connection before the next event if no frame is painted
+    if (painted)
+        XFlush(s.dpy);
+}
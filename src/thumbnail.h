@@ -0,0 +1,38 @@
+#pragma once
+
+#include "window.h"
+#include <X11/Xlib.h>
+
+/*
+ * downscaled copies of windows for task switchers and pagers, painted on the event connection
+ * a thumbnail is a THUMBNAIL_SIZE square ARGB pixmap other clients can draw from, the window is centered
+ * in it keeping its aspect ratio, it keeps the last contents of unmapped windows
+ * thumbnails are made when first asked for, repainted at most every THUMBNAIL_INTERVAL while their window
+ * is damaged and freed THUMBNAIL_TTL after they were last asked for
+ */
+
+#define THUMBNAIL_SIZE 256
+#define THUMBNAIL_INTERVAL 250 // milliseconds
+#define THUMBNAIL_TTL 60000    // milliseconds
+
+/*
+ * returns the thumbnail of w and the part of it the window covers, None if w has no contents
+ */
+Pixmap thumbnail_get(win *w, XRectangle *content);
+
+/*
+ * marks the thumbnail of w outdated, if it has one
+ */
+void thumbnail_damage(win *w);
+
+void thumbnail_cleanup(win *w);
+
+/*
+ * returns the poll timeout until the next thumbnail repaint or expiry, -1 if there is none
+ */
+int thumbnail_timeout(void);
+
+/*
+ * repaints the outdated thumbnails that are due and frees expired ones
+ */
+void thumbnail_run(void);
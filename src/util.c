@@ -6,6 +6,14 @@
 #include <X11/extensions/Xrender.h>
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
+
+double get_time_in_milliseconds(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
 
 #ifdef DEBUG
 static const char *event_names[] = {
@@ -68,33 +76,58 @@ Window ev_window(XEvent *ev) {
 }
 #endif
 
-static unsigned long int *ignores = NULL;
-static size_t n_ignores = 0, size_ignores = 0;
+/*
+ * sequences to ignore errors for, stored in a ring buffer
+ * sequences are always added in increasing order (NextRequest()) so the oldest one is at the head
+ * and discarding passed sequences only moves the head forward
+ * each thread uses its own X connection so the ring is thread local
+ */
+static _Thread_local unsigned long int *ignores = NULL;
+static _Thread_local size_t ignores_head = 0, n_ignores = 0, size_ignores = 0; // size_ignores is always a power of 2
+
+struct error_counters error_counters;
+
+#define IGNORE_AT(i) ignores[(ignores_head + (i)) & (size_ignores - 1)]
+
+static void grow_ignores(void) {
+    size_t new_size = size_ignores ? size_ignores * 2 : 256;
+    unsigned long int *new_ignores = ecalloc(new_size, sizeof(*ignores));
+    for (size_t i = 0; i < n_ignores; i++)
+        new_ignores[i] = IGNORE_AT(i);
+    free(ignores);
+    ignores = new_ignores;
+    ignores_head = 0;
+    size_ignores = new_size;
+}
 
 void discard_ignore(unsigned long int sequence) {
-    size_t i;
-    for (i = 0; i < n_ignores && sequence > ignores[i]; i++)
-        ;
-    memmove(ignores, &ignores[i], (n_ignores -= i) * sizeof(*ignores));
+    while (n_ignores && sequence > ignores[ignores_head]) {
+        ignores_head = (ignores_head + 1) & (size_ignores - 1);
+        n_ignores--;
+    }
 }
 
 void set_ignore(unsigned long int sequence) {
     if (n_ignores == size_ignores)
-        ignores = erealloc(ignores, (size_ignores += 64) * sizeof(*ignores));
-    ignores[n_ignores++] = sequence;
+        grow_ignores();
+    IGNORE_AT(n_ignores) = sequence;
+    n_ignores++;
 }
 
 int should_ignore(unsigned long int sequence) {
     discard_ignore(sequence);
-    return n_ignores && ignores[0] == sequence;
+    return n_ignores && ignores[ignores_head] == sequence;
 }
 
 int handle_error(Display *display, XErrorEvent *ev) {
     const char *name = NULL;
     static char buffer[256];
 
-    if (should_ignore(ev->serial))
+    if (should_ignore(ev->serial)) {
+        atomic_fetch_add_explicit(&error_counters.ignored, 1, memory_order_relaxed);
         return 0;
+    }
+    atomic_fetch_add_explicit(&error_counters.reported, 1, memory_order_relaxed);
 
     if (ev->request_code == s.composite_opcode && ev->minor_code == X_CompositeRedirectSubwindows)
         eprintf("another composite manager is already running\n");
@@ -2,6 +2,7 @@
 
 #include <X11/Xlib.h>
 #include <inttypes.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 
@@ -14,9 +15,24 @@
      (DEST)->height = (SRC)->height)
 
 #define eprintf(...) (fprintf(stderr, __VA_ARGS__), exit(EXIT_FAILURE))
-#define erealloc(P, N) ((tmp_ = realloc((P), (N))) ? tmp_ : (eprintf("realloc: out of memory\n"), NULL))
-#define ecalloc(N, M) ((tmp_ = calloc((N), (M))) ? tmp_ : (eprintf("calloc: out of memory\n"), NULL))
-void *tmp_;
+
+// the result is kept in a local, both threads allocate
+static inline void *erealloc(void *p, size_t n) {
+    void *q = realloc(p, n);
+    if (!q)
+        eprintf("realloc: out of memory\n");
+    return q;
+}
+
+static inline void *ecalloc(size_t n, size_t m) {
+    void *p = calloc(n, m);
+    if (!p)
+        eprintf("calloc: out of memory\n");
+    return p;
+}
+
+// time of the monotonic clock
+double get_time_in_milliseconds(void);
 
 #ifdef DEBUG
 #define print_event(ev) printf("[XEvent] %17.17s - serial: 0x%08x, window: 0x%08lx\n", ev_name(&ev), ev_serial(&ev), ev_window(&ev))
@@ -26,6 +42,13 @@ const char *ev_name(XEvent *ev);
 Window ev_window(XEvent *ev);
 #endif
 
+struct error_counters {
+    atomic_ulong ignored;  // errors caused by requests marked with set_ignore()
+    atomic_ulong reported; // errors printed by handle_error(), on either connection
+};
+
+extern struct error_counters error_counters;
+
 void discard_ignore(unsigned long int sequence);
 void set_ignore(unsigned long int sequence);
 int should_ignore(unsigned long int sequence);
@@ -1,11 +1,21 @@
 #include "window.h"
 #include "action.h"
+#include "desktop.h"
 #include "effect.h"
+#include "memory.h"
+#include "morph.h"
+#include "pool.h"
 #include "render.h"
+#include "retain.h"
+#include "rule.h"
+#include "scene.h"
 #include "session.h"
+#include "thumbnail.h"
 #include "util.h"
 #include <X11/Xatom.h>
 #include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/Xcomposite.h>
 #include <X11/extensions/shape.h>
 #include <stdlib.h>
 #include <string.h>
@@ -21,6 +31,10 @@ wintype get_wintype_from_name(const char *name) {
     return WINTYPE_UNKNOWN;
 }
 
+const char *get_wintype_name(wintype window_type) {
+    return window_type < NUM_WINTYPES ? wintypes_names[window_type] : "unknown";
+}
+
 /*
  * returns the window that truly holds the window properties or 'None' if it could not find it
  */
@@ -50,19 +64,43 @@ win *find_win(Window id, Bool include_prop_window) {
     return NULL;
 }
 
+/*
+ * returns the geometry w is painted at, borders included
+ */
+static void win_geometry(win *w, XRectangle *r) {
+    if (w->morph_picture) {
+        *r = w->morph_geometry;
+        return;
+    }
+    COPY_AREA(r, &w->attr);
+    r->width += w->attr.border_width * 2;
+    r->height += w->attr.border_width * 2;
+}
+
 XserverRegion win_extents(win *w) {
-    XRectangle r;
+    XRectangle r[2];
 
-    COPY_AREA(&r, &w->attr);
-    r.width += w->attr.border_width * 2;
-    r.height += w->attr.border_width * 2;
+    win_geometry(w, &r[0]);
+
+    if (!w->shadow)
+        return region_get(&event_regions, r, 1);
 
-    return XFixesCreateRegion(s.dpy, &r, 1);
+    r[1].x = r[0].x + s.shadow_offset_x - s.shadow_radius;
+    r[1].y = r[0].y + s.shadow_offset_y - s.shadow_radius;
+    r[1].width = r[0].width + s.shadow_radius * 2;
+    r[1].height = r[0].height + s.shadow_radius * 2;
+    return region_get(&event_regions, r, 2);
 }
 
 XserverRegion border_size(win *w) {
     XserverRegion border;
+
+    // the shape of the window is not stretched with its previous contents
+    if (w->morph_picture)
+        return XFixesCreateRegion(s.dpy, &w->morph_geometry, 1);
     /*
+     * not taken from the region pool, a region that failed to be created here must never be reused
+     *
      * if window doesn't exist anymore,  this will generate an error
      * as well as not generate a region.  Perhaps a better XFixes
      * architecture would be to have a request that copies instead
@@ -79,8 +117,144 @@ XserverRegion border_size(win *w) {
     return border;
 }
 
+XserverRegion opaque_region(win *w) {
+    XserverRegion opaque = region_get(&event_regions, w->opaque_rects, w->n_opaque_rects);
+    XFixesTranslateRegion(s.dpy, opaque,
+                          w->attr.x + w->attr.border_width,
+                          w->attr.y + w->attr.border_width);
+    set_ignore(NextRequest(s.dpy));
+    XFixesIntersectRegion(s.dpy, opaque, opaque, w->border_size);
+    return opaque;
+}
+
+static void win_bounds(win *w, XRectangle *r) {
+    win_geometry(w, r);
+    if (!w->shadow)
+        return;
+
+    // bounding box of the window and its shadow
+    int dx = s.shadow_offset_x - s.shadow_radius, dy = s.shadow_offset_y - s.shadow_radius;
+    int x2 = r->x + r->width, y2 = r->y + r->height;
+    if (dx < 0)
+        r->x += dx;
+    if (dy < 0)
+        r->y += dy;
+    if (dx + s.shadow_radius * 2 > 0)
+        x2 += dx + s.shadow_radius * 2;
+    if (dy + s.shadow_radius * 2 > 0)
+        y2 += dy + s.shadow_radius * 2;
+    r->width = x2 - r->x;
+    r->height = y2 - r->y;
+}
+
+void invalidate_blur(win *w, XRectangle *r) {
+    for (win *b = s.managed_windows; b && b != w; b = b->next) {
+        if (!b->blur_background || b->blur_dirty)
+            continue;
+        if (r->x < b->attr.x + b->attr.width + b->attr.border_width * 2 && b->attr.x < r->x + r->width &&
+            r->y < b->attr.y + b->attr.height + b->attr.border_width * 2 && b->attr.y < r->y + r->height)
+            b->blur_dirty = True;
+    }
+}
+
 static wintype determine_wintype(win *w);
 
+void apply_effect_rules(win *w) {
+    const window_rule *rule = w->rule;
+
+    w->shadow = rule && rule->shadow >= 0 ? rule->shadow : s.wintype_shadows[w->window_type];
+    w->blur_background = s.wintype_blurs[w->window_type];
+    w->corner_radius = s.wintype_corner_radius[w->window_type];
+    w->dim_inactive = s.wintype_dims[w->window_type];
+    if (w->unredirect_override >= 0)
+        w->unredirect = w->unredirect_override;
+    else
+        w->unredirect = rule && rule->unredirect > 0;
+    if (s.effects_paused) {
+        w->shadow = False;
+        w->blur_background = False;
+    }
+}
+
+double default_opacity(win *w) {
+    return w->rule && w->rule->opacity >= 0.0 ? w->rule->opacity : 1.0;
+}
+
+/*
+ * returns a copy of the text of property, NULL if it is not set
+ */
+static char *get_text_prop(Window id, Atom property) {
+    XTextProperty tp;
+    char **list;
+    int n;
+    char *text = NULL;
+
+    if (!XGetTextProperty(s.dpy, id, &tp, property))
+        return NULL;
+    if (Xutf8TextPropertyToTextList(s.dpy, &tp, &list, &n) >= Success && list) {
+        if (n > 0)
+            text = strdup(list[0]);
+        XFreeStringList(list);
+    }
+    XFree(tp.value);
+    return text;
+}
+
+Bool determine_rule(win *w, Atom property) {
+    rule_set *rules = effect_rules();
+    const window_rule *rule = NULL;
+    Bool all = property == None;
+
+    if (rules && rules->n_rules) {
+        if (rules->uses_class && (all || property == XA_WM_CLASS)) {
+            XClassHint hint;
+            free(w->res_name);
+            free(w->res_class);
+            w->res_name = w->res_class = NULL;
+            if (XGetClassHint(s.dpy, w->props_window_id, &hint)) {
+                w->res_name = hint.res_name ? strdup(hint.res_name) : NULL;
+                w->res_class = hint.res_class ? strdup(hint.res_class) : NULL;
+                XFree(hint.res_name);
+                XFree(hint.res_class);
+            }
+        }
+        if (rules->uses_name && (all || property == XA_WM_NAME || property == s.net_wm_name_atom)) {
+            free(w->name);
+            w->name = get_text_prop(w->props_window_id, s.net_wm_name_atom);
+            if (!w->name)
+                w->name = get_text_prop(w->props_window_id, XA_WM_NAME);
+        }
+        if (rules->uses_role && (all || property == s.role_atom)) {
+            free(w->role);
+            w->role = get_text_prop(w->props_window_id, s.role_atom);
+        }
+        rule = rule_match(rules, w->res_name, w->res_class, w->name, w->role);
+    }
+
+    if (rule == w->rule)
+        return False;
+    w->rule = rule;
+    return True;
+}
+
+void refresh_effect_rules(win *w) {
+    apply_effect_rules(w);
+    if (w->attr.map_state != IsViewable)
+        return;
+
+    w->opacity = get_opacity_prop(w, default_opacity(w));
+    determine_mode(w); // damages the previous extents
+    if (w->extents) {
+        // the shadow may have been turned on or off
+        region_put(&event_regions, w->extents);
+        w->extents = win_extents(w);
+        XserverRegion damage = region_scratch(&event_regions);
+        XFixesCopyRegion(s.dpy, damage, w->extents);
+        add_damage(damage);
+    }
+    s.clip_changed = True;
+}
+
 void map_win(Window id) {
     win *w = find_win(id, False);
     if (!w)
@@ -94,38 +268,105 @@ void map_win(Window id) {
     if (is_being_created) {
         w->props_window_id = get_prop_window(w->id);
         w->window_type = determine_wintype(w);
+        determine_rule(w, None);
+        apply_effect_rules(w);
+        // the focus may have been given before the property window was known
+        if (!s.active_window)
+            determine_active_win();
     }
 
     // This needs to be here or else we lose transparency messages
     XSelectInput(s.dpy, w->props_window_id, PropertyChangeMask);
 
     // This needs to be here since we don't get PropertyNotify when unmapped
-    w->opacity = get_opacity_prop(w, 1.0);
+    determine_desktop(w);
+    w->opacity = get_opacity_prop(w, default_opacity(w));
     determine_mode(w);
+    if (w->mode == WINDOW_ARGB)
+        determine_opaque_region(w);
 
     w->damaged = False;
+    w->evicted = False;
+
+    // the contents it had when it was unmapped are drawn until its client repaints it
+    if (retain_take(w)) {
+        XRectangle r;
+        win_bounds(w, &r);
+        invalidate_blur(w, &r);
+        add_damage(win_extents(w));
+        w->damaged = True;
+        w->stale = True;
+        s.clip_changed = True;
+    }
 
     effect *e;
-    if ((e = effect_get(w->window_type, is_being_created ? EVENT_WINDOW_CREATE : EVENT_WINDOW_MAP)))
+    if (!desktop_switching(w) && (e = effect_get(w, is_being_created ? EVENT_WINDOW_CREATE : EVENT_WINDOW_MAP)))
         action_set(w, e, False, NULL, False, True);
 }
 
+Pixmap name_win_pixmap(win *w) {
+    w->pixmap = XCompositeNameWindowPixmap(s.dpy, w->id);
+    if (w->pixmap) {
+        w->pixmap_bytes = memory_pixmap_bytes(w->attr.width + w->attr.border_width * 2,
+                                              w->attr.height + w->attr.border_width * 2, w->attr.depth);
+        memory_add(MEMORY_WINDOWS, w->pixmap_bytes);
+    }
+    return w->pixmap;
+}
+
+void free_win_pixmap(win *w) {
+    if (w->pixmap) {
+        XFreePixmap(s.dpy, w->pixmap);
+        memory_add(MEMORY_WINDOWS, -(long int) w->pixmap_bytes);
+        w->pixmap = None;
+        w->pixmap_bytes = 0;
+    }
+    if (w->picture) {
+        scene_release_picture(w->picture);
+        w->picture = None;
+    }
+    w->stale = False;
+}
+
+Bool win_occluded(win *w) {
+    XRectangle r;
+    win_bounds(w, &r);
+
+    for (win *a = s.managed_windows; a && a != w; a = a->next) {
+        // only windows painted as a plain opaque rectangle hide what is below them
+        if (a->attr.map_state != IsViewable || !a->damaged || a->evicted || a->mode != WINDOW_SOLID ||
+            a->shaped || a->corner_radius || a->action_running || a->morph_picture)
+            continue;
+        if (a->attr.x <= r.x && a->attr.y <= r.y &&
+            a->attr.x + a->attr.width + a->attr.border_width * 2 >= r.x + r.width &&
+            a->attr.y + a->attr.height + a->attr.border_width * 2 >= r.y + r.height)
+            return True;
+    }
+    return False;
+}
+
+void evict_win_pixmap(win *w) {
+    free_win_pixmap(w);
+    w->damaged = False;
+    w->evicted = True;
+}
+
 void finish_unmap_win(win *w) {
     w->damaged = False;
+    w->stale = False;
+    w->evicted = False;
 
     if (w->extents != None) {
         add_damage(w->extents); // destroys region
         w->extents = None;
     }
 
-    if (w->pixmap) {
-        XFreePixmap(s.dpy, w->pixmap);
-        w->pixmap = None;
-    }
+    // the named pixmap keeps the last contents of the window after it is unmapped
+    if (w->pixmap)
+        retain_put(w);
 
     if (w->picture) {
-        set_ignore(NextRequest(s.dpy));
-        XRenderFreePicture(s.dpy, w->picture);
+        scene_release_picture(w->picture);
         w->picture = None;
     }
 
@@ -134,13 +375,13 @@ void finish_unmap_win(win *w) {
     XSelectInput(s.dpy, w->id, 0);
 
     if (w->border_size) {
-        set_ignore(NextRequest(s.dpy));
-        XFixesDestroyRegion(s.dpy, w->border_size);
+        scene_release_region(w->border_size);
         w->border_size = None;
     }
-    if (w->border_clip) {
-        XFixesDestroyRegion(s.dpy, w->border_clip);
-        w->border_clip = None;
+
+    if (w->opaque_region) {
+        scene_recycle_region(w->opaque_region);
+        w->opaque_region = None;
     }
 
     s.clip_changed = True;
@@ -155,8 +396,10 @@ void unmap_win(Window id) {
     if (!w)
         return;
     w->attr.map_state = IsUnmapped;
+    // the unmap effect animates the window where it is now
+    morph_cleanup(w);
     effect *e;
-    if ((e = effect_get(w->window_type, EVENT_WINDOW_UNMAP)) && w->pixmap)
+    if (!desktop_switching(w) && (e = effect_get(w, EVENT_WINDOW_UNMAP)) && w->pixmap)
         action_set(w, e, True, unmap_callback, False, False);
     else
         finish_unmap_win(w);
@@ -187,11 +430,6 @@ void determine_mode(win *w) {
     int mode;
     XRenderPictFormat *format;
 
-    if (w->alpha_picture) {
-        XRenderFreePicture(s.dpy, w->alpha_picture);
-        w->alpha_picture = None;
-    }
-
     if (w->attr.class == InputOnly) {
         format = NULL;
     } else {
@@ -206,9 +444,14 @@ void determine_mode(win *w) {
         mode = WINDOW_SOLID;
     }
     w->mode = mode;
+    w->blur_dirty = True;
     if (w->extents) {
+        XRectangle r;
+        win_bounds(w, &r);
+        invalidate_blur(w, &r);
+
         XserverRegion damage;
-        damage = XFixesCreateRegion(s.dpy, NULL, 0);
+        damage = region_scratch(&event_regions);
         XFixesCopyRegion(s.dpy, damage, w->extents);
         add_damage(damage);
     }
@@ -270,6 +513,89 @@ void determine_winstate(win *w) {
     }
 }
 
+void determine_opaque_region(win *w) {
+    Atom actual;
+    int format;
+    unsigned long n, left;
+
+    free(w->opaque_rects);
+    w->opaque_rects = NULL;
+    w->n_opaque_rects = 0;
+
+    unsigned char *data;
+    int result = XGetWindowProperty(s.dpy, w->props_window_id, s.opaque_region_atom, 0L, 4096L, False,
+                                    XA_CARDINAL, &actual, &format,
+                                    &n, &left, &data);
+    if (result == Success && data != NULL) {
+        // the property is relative to the client window, which may be a child of the managed window
+        int dx = 0, dy = 0;
+        Window child;
+        if (w->props_window_id != w->id)
+            XTranslateCoordinates(s.dpy, w->props_window_id, w->id, 0, 0, &dx, &dy, &child);
+
+        long *values = (long *) data;
+        w->n_opaque_rects = n / 4;
+        if (w->n_opaque_rects)
+            w->opaque_rects = ecalloc(w->n_opaque_rects, sizeof(XRectangle));
+        for (int i = 0; i < w->n_opaque_rects; i++) {
+            w->opaque_rects[i].x = values[i * 4] + dx;
+            w->opaque_rects[i].y = values[i * 4 + 1] + dy;
+            w->opaque_rects[i].width = values[i * 4 + 2];
+            w->opaque_rects[i].height = values[i * 4 + 3];
+        }
+        XFree((void *) data);
+    }
+
+    if (w->opaque_region) {
+        scene_recycle_region(w->opaque_region);
+        w->opaque_region = None;
+    }
+    if (w->extents) {
+        XserverRegion damage = region_scratch(&event_regions);
+        XFixesCopyRegion(s.dpy, damage, w->extents);
+        add_damage(damage);
+    }
+}
+
+static void damage_focus_change(win *w) {
+    if (!w || !w->dim_inactive || !w->damaged)
+        return;
+
+    XRectangle r;
+    COPY_AREA(&r, &w->attr);
+    r.width += w->attr.border_width * 2;
+    r.height += w->attr.border_width * 2;
+    invalidate_blur(w, &r);
+    add_damage(region_get(&event_regions, &r, 1));
+}
+
+void determine_active_win(void) {
+    Atom actual;
+    int format;
+    unsigned long n, left;
+    Window active = None;
+
+    unsigned char *data;
+    int result = XGetWindowProperty(s.dpy, s.root, s.active_atom, 0L, 1L, False,
+                                    XA_WINDOW, &actual, &format,
+                                    &n, &left, &data);
+    if (result == Success && data != NULL) {
+        if (n == 1)
+            active = *(Window *) data;
+        XFree((void *) data);
+    }
+
+    // the active window is a client window, it may be the property window of a frame
+    win *w = active ? find_win(active, True) : NULL;
+    Window id = w ? w->id : None;
+    if (id == s.active_window)
+        return;
+
+    damage_focus_change(find_win(s.active_window, False));
+    s.active_window = id;
+    damage_focus_change(w);
+}
+
 void add_win(Window id) {
     win *w = ecalloc(1, sizeof(win));
     w->id = id;
@@ -286,29 +612,45 @@ void add_win(Window id) {
     w->shape_bounds.height = w->attr.height;
 
     w->damaged = False;
+    w->stale = False;
+    w->evicted = False;
     w->pixmap = None;
+    w->pixmap_bytes = 0;
     w->picture = None;
 
     w->damage = w->attr.class == InputOnly ? None : XDamageCreate(s.dpy, id, XDamageReportNonEmpty);
 
-    w->alpha_picture = None;
     w->border_size = None;
     w->extents = None;
     w->opacity = 1.0;
-    w->border_clip = None;
 
     w->scale = 1.0;
     w->offset_x = 0;
     w->offset_y = 0;
     w->need_effect = False;
+    w->morph_picture = None;
     w->action_running = False;
+    w->shadow = False;
+    w->blur_background = False;
+    w->blur_dirty = False;
+    w->corner_radius = 0;
+    w->dim_inactive = False;
+    w->opaque_rects = NULL;
+    w->n_opaque_rects = 0;
+    w->opaque_region = None;
+    w->res_name = NULL;
+    w->res_class = NULL;
+    w->name = NULL;
+    w->role = NULL;
+    w->rule = NULL;
+    w->unredirect = False;
+    w->unredirect_override = -1;
 
     w->maximize_state_changed = False;
     w->state = 0;
 
-    w->prev_trans = NULL;
-
     w->window_type = WINTYPE_UNKNOWN;
+    w->desktop = -1;
 
     w->next = s.managed_windows;
     s.managed_windows = w;
@@ -345,41 +687,42 @@ void configure_win(XConfigureEvent *ce) {
 
     if (!w) {
         if (ce->window == s.root) {
-            if (s.root_buffer) {
-                XRenderFreePicture(s.dpy, s.root_buffer);
-                s.root_buffer = None;
-            }
+            // the renderer reallocates its buffer when it gets a scene of a different size
             s.root_width = ce->width;
             s.root_height = ce->height;
+            XRectangle r = {0, 0, s.root_width, s.root_height};
+            add_damage(region_get(&event_regions, &r, 1));
         }
         return;
     }
 
     // if maximize_state_changed and we are in a configure event, this is a real maximize/fullscreen state change
-    // maybe add a check if the configure event if really for a window resize/move
-    if (w->maximize_state_changed) {
-        effect *e;
-        if ((e = effect_get(w->window_type, EVENT_WINDOW_MAXIMIZE)) && w->pixmap)
+    Bool moved = w->attr.x != ce->x || w->attr.y != ce->y || w->attr.width != ce->width ||
+                 w->attr.height != ce->height || w->attr.border_width != ce->border_width;
+    if ((w->maximize_state_changed || moved) && w->attr.map_state == IsViewable && !desktop_switching(w)) {
+        effect *e = effect_get(w, w->maximize_state_changed ? EVENT_WINDOW_MAXIMIZE : EVENT_WINDOW_MOVE);
+        // the previous contents and geometry are kept before the window pixmap is freed
+        if (e && effect_is_morph(e))
+            morph_start(w, e);
+        // an interactive move sends a configure per motion, its animation is not started again by each one
+        else if (e && w->pixmap && (w->maximize_state_changed || !w->action_running))
             action_set(w, e, False, NULL, False, True);
-        w->maximize_state_changed = False;
     }
+    w->maximize_state_changed = False;
 
-    damage = XFixesCreateRegion(s.dpy, NULL, 0);
-    if (w->extents != None)
+    if (w->extents != None) {
+        damage = region_scratch(&event_regions);
         XFixesCopyRegion(s.dpy, damage, w->extents);
+    } else
+        damage = region_get(&event_regions, NULL, 0);
 
     w->shape_bounds.x -= w->attr.x;
     w->shape_bounds.y -= w->attr.y;
 
     if (w->attr.width != ce->width || w->attr.height != ce->height) {
-        if (w->pixmap) {
-            XFreePixmap(s.dpy, w->pixmap);
-            w->pixmap = None;
-            if (w->picture) {
-                XRenderFreePicture(s.dpy, w->picture);
-                w->picture = None;
-            }
-        }
+        if (w->pixmap)
+            free_win_pixmap(w);
+        retain_drop(w);
     }
 
     COPY_AREA(&w->attr, ce);
@@ -389,7 +732,7 @@ void configure_win(XConfigureEvent *ce) {
     if (damage) {
         XserverRegion extents = win_extents(w);
         XFixesUnionRegion(s.dpy, damage, damage, extents);
-        XFixesDestroyRegion(s.dpy, extents);
+        region_put(&event_regions, extents);
         add_damage(damage);
     }
     w->shape_bounds.x += w->attr.x;
@@ -421,24 +764,30 @@ static void finish_destroy_win(Window id, Bool gone) {
     win **prev, *w;
     for (prev = &s.managed_windows; (w = *prev); prev = &w->next) {
         if (w->id == id) {
-            if (gone)
+            morph_cleanup(w);
+            if (gone) {
+                // the contents of a destroyed window are not retained
+                free_win_pixmap(w);
                 finish_unmap_win(w);
+            }
+            retain_drop(w);
             *prev = w->next;
             if (w->picture) {
-                set_ignore(NextRequest(s.dpy));
-                XRenderFreePicture(s.dpy, w->picture);
+                scene_release_picture(w->picture);
                 w->picture = None;
             }
-            if (w->alpha_picture) {
-                XRenderFreePicture(s.dpy, w->alpha_picture);
-                w->alpha_picture = None;
-            }
             if (w->damage != None) {
                 set_ignore(NextRequest(s.dpy));
                 XDamageDestroy(s.dpy, w->damage);
                 w->damage = None;
             }
             action_cleanup(w);
+            thumbnail_cleanup(w);
+            free(w->opaque_rects);
+            free(w->res_name);
+            free(w->res_class);
+            free(w->name);
+            free(w->role);
             free(w);
             break;
         }
@@ -452,7 +801,7 @@ static void destroy_callback(win *w, Bool gone) {
 void destroy_win(Window id, Bool gone) {
     win *w = find_win(id, False);
     effect *e;
-    if (w && (e = effect_get(w->window_type, EVENT_WINDOW_DESTROY)) && w->pixmap)
+    if (w && (e = effect_get(w, EVENT_WINDOW_DESTROY)) && w->pixmap)
         action_set(w, e, True, destroy_callback, gone, False);
     else
         finish_destroy_win(id, gone);
@@ -460,22 +809,44 @@ void destroy_win(Window id, Bool gone) {
 
 void damage_win(XDamageNotifyEvent *de) {
     XserverRegion parts;
+    XRectangle r;
     win *w = find_win(de->drawable, False);
     if (!w)
         return;
 
-    if (!w->damaged) {
+    if (w->evicted) {
+        // hidden, it is read again when it is visible, until then its damage is only acknowledged
+        set_ignore(NextRequest(s.dpy));
+        XDamageSubtract(s.dpy, w->damage, None, None);
+        return;
+    }
+
+    if (w->stale) {
+        // its client repainted it, the retained contents are replaced by the current ones everywhere
+        free_win_pixmap(w);
+        w->damaged = False;
+    }
+
+    // the contents of a window whose move or resize is animated are painted stretched elsewhere
+    if (!w->damaged || w->morph_picture) {
+        win_bounds(w, &r);
         parts = win_extents(w);
         set_ignore(NextRequest(s.dpy));
         XDamageSubtract(s.dpy, w->damage, None, None);
     } else {
-        parts = XFixesCreateRegion(s.dpy, NULL, 0);
+        parts = region_get(&event_regions, NULL, 0);
         set_ignore(NextRequest(s.dpy));
         XDamageSubtract(s.dpy, w->damage, None, parts);
         XFixesTranslateRegion(s.dpy, parts,
                               w->attr.x + w->attr.border_width,
                               w->attr.y + w->attr.border_width);
+        r.x = de->area.x + w->attr.x + w->attr.border_width;
+        r.y = de->area.y + w->attr.y + w->attr.border_width;
+        r.width = de->area.width;
+        r.height = de->area.height;
     }
+    invalidate_blur(w, &r);
+    thumbnail_damage(w);
     add_damage(parts);
     w->damaged = True;
 }
@@ -492,7 +863,7 @@ void shape_win(XShapeEvent *se) {
 
         s.clip_changed = True;
 
-        region0 = XFixesCreateRegion(s.dpy, &w->shape_bounds, 1);
+        region0 = region_get(&event_regions, &w->shape_bounds, 1);
 
         if (se->shaped == True) {
             w->shaped = True;
@@ -508,11 +879,11 @@ void shape_win(XShapeEvent *se) {
             w->shape_bounds.height = w->attr.height;
         }
 
-        region1 = XFixesCreateRegion(s.dpy, &w->shape_bounds, 1);
+        region1 = region_get(&event_regions, &w->shape_bounds, 1);
         XFixesUnionRegion(s.dpy, region0, region0, region1);
-        XFixesDestroyRegion(s.dpy, region1);
+        region_put(&event_regions, region1);
 
-        /* ask for repaint of the old and new region */
-        paint_all(region0);
+        /* ask for repaint of the old and new region, painted with the next frame */
+        add_damage(region0);
     }
 }
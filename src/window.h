@@ -9,6 +9,8 @@
 #define WINDOW_TRANS 1
 #define WINDOW_ARGB 2
 
+#define DESKTOP_ALL 0xFFFFFFFF // _NET_WM_DESKTOP of a window shown on every desktop
+
 typedef enum _winstate {
     WINSTATE_MAXIMIZED_VERT = 1,
     WINSTATE_MAXIMIZED_HORZ = 2,
@@ -39,6 +41,7 @@ typedef struct _win {
     struct _win *next;
     Window id;
     Pixmap pixmap;
+    unsigned long int pixmap_bytes; // server memory held by pixmap
     XWindowAttributes attr;
 
     // some programs do not put their properties their window but in a child window (see xterm)
@@ -49,12 +52,14 @@ typedef struct _win {
     Bool maximize_state_changed;
     unsigned int state;
     Bool damaged;
+    Bool stale; // pixmap holds the contents it had when it was last unmapped, until its client repaints it
+    Bool evicted; // its pixmap was freed to fit the memory budget while an opaque window hid it
     Damage damage;
     Picture picture;
-    Picture alpha_picture;
     XserverRegion border_size;
     XserverRegion extents;
     wintype window_type;
+    long desktop; // _NET_WM_DESKTOP, -1 if the window manager did not set it
     Bool shaped;
     XRectangle shape_bounds;
 
@@ -63,11 +68,31 @@ typedef struct _win {
     int offset_x;
     int offset_y;
     Bool need_effect; // used to apply effects when painting a window
+    // while a move or resize is animated (see src/morph.h) the contents from before it are painted
+    // at morph_geometry instead of the window, stretched from their morph_width x morph_height size
+    Picture morph_picture;
+    XRectangle morph_geometry;
+    int morph_width, morph_height;
     Bool action_running;
-
-    /* for drawing translucent windows */
-    XserverRegion border_clip;
-    struct _win *prev_trans;
+    Bool shadow;
+    Bool blur_background;
+    Bool blur_dirty; // something below the window changed since its background was last blurred
+    int corner_radius;
+    Bool dim_inactive;
+
+    // _NET_WM_OPAQUE_REGION of an ARGB window, relative to the window
+    XRectangle *opaque_rects;
+    int n_opaque_rects;
+    XserverRegion opaque_region; // opaque_rects in root coordinates, created with border_size
+
+    // properties effect-rules window sections match on, only read if a rule uses them, NULL if unset
+    char *res_name;
+    char *res_class;
+    char *name;
+    char *role;
+    const struct _window_rule *rule; // first window section matching the window, NULL if none does
+    Bool unredirect;                 // drawn by the server while it covers the screen on top of the others
+    int unredirect_override;         // unredirect forced through the control socket, -1 to follow the rule
 } win;
 
 #define WIN_SET_STATE(w, wstate) w->state |= 1U << wstate
@@ -75,12 +100,41 @@ typedef struct _win {
 
 wintype get_wintype_from_name(const char *name);
 
+const char *get_wintype_name(wintype window_type);
+
 win *find_win(Window id, Bool include_prop_window);
 
 XserverRegion win_extents(win *w);
 
 XserverRegion border_size(win *w);
 
+XserverRegion opaque_region(win *w);
+
+/*
+ * marks the blurred backgrounds overlapping r of windows above w as outdated (all windows if w is NULL)
+ */
+void invalidate_blur(win *w, XRectangle *r);
+
+/*
+ * names the pixmap holding the contents of w, returns None if it cannot be named
+ */
+Pixmap name_win_pixmap(win *w);
+
+/*
+ * frees the pixmap of w and its picture, they are named again when w is painted
+ */
+void free_win_pixmap(win *w);
+
+/*
+ * returns True if an opaque window above w covers it and its shadow entirely
+ */
+Bool win_occluded(win *w);
+
+/*
+ * frees the pixmap of w, which is occluded, it is not painted until it is visible again
+ */
+void evict_win_pixmap(win *w);
+
 void map_win(Window id);
 
 void finish_unmap_win(win *w);
@@ -97,6 +151,38 @@ void determine_mode(win *w);
 
 void determine_winstate(win *w);
 
+/*
+ * sets the effect-rules options of w from its type and its window rule
+ */
+void apply_effect_rules(win *w);
+
+/*
+ * returns the opacity of w when it has no _NET_WM_WINDOW_OPACITY
+ */
+double default_opacity(win *w);
+
+/*
+ * reads the properties the window rules match on (all of them if property is None) and matches w again,
+ * returns True if its rule changed
+ */
+Bool determine_rule(win *w, Atom property);
+
+/*
+ * applies the effect-rules of w again and damages it, after its rule or the config changed
+ */
+void refresh_effect_rules(win *w);
+
+/*
+ * reads the part of an ARGB window its client declared opaque, it is painted like a solid window
+ */
+void determine_opaque_region(win *w);
+
+/*
+ * updates s.active_window from the _NET_ACTIVE_WINDOW root property
+ * and damages the windows that lost and gained the focus
+ */
+void determine_active_win(void);
+
 void add_win(Window id);
 
 void restack_win(win *w, Window new_above);